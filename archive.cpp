@@ -0,0 +1,205 @@
+#include "archive.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <dirent.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
+#include "block_format.h"
+#include "encoding_table.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "work_stealing_pool.h"
+
+//Adds the files under the directory, without following symbolic links, which could lead back to the directory.
+static bool collect_directory(const std::string& path,std::vector<std::string>& files){
+    DIR* directory = opendir(path.c_str());
+    if(!directory)
+        return false;
+    std::vector<std::string> names;
+    while(dirent* entry = readdir(directory)){
+        if(strcmp(entry->d_name,".") != 0 && strcmp(entry->d_name,"..") != 0)
+            names.push_back(entry->d_name);
+    }
+    closedir(directory);
+    std::sort(names.begin(),names.end());
+    std::string prefix = path.back() == '/' ? path : path + "/";
+    for(auto& name:names){
+        std::string child = prefix + name;
+        struct stat status;
+        if(lstat(child.c_str(),&status) != 0)
+            return false;
+        if(S_ISREG(status.st_mode))
+            files.push_back(child);
+        else if(S_ISDIR(status.st_mode) && !collect_directory(child,files))
+            return false;
+    }
+    return true;
+}
+
+bool collect_files(const std::string& path,std::vector<std::string>& files){
+    struct stat status;
+    if(path.empty() || stat(path.c_str(),&status) != 0)
+        return false;
+    if(S_ISREG(status.st_mode)){
+        files.push_back(path);
+        return true;
+    }
+    return S_ISDIR(status.st_mode) && collect_directory(path,files);
+}
+
+//Appends the member index block to the buffer.  All of its numbers are written with write_number.
+static void write_archive_index(std::vector<unsigned char>& destination,const std::vector<archive_member>& members){
+    std::vector<unsigned char> payload;
+    write_number(payload,members.size());
+    for(auto& member:members){
+        write_number(payload,member.path.size());
+        payload.insert(payload.end(),member.path.begin(),member.path.end());
+        write_number(payload,member.size);
+        write_number(payload,member.blocks.size());
+        for(auto offset:member.blocks){
+            write_number(payload,offset);
+        }
+    }
+    block_header header = {FILE_INDEX_BLOCK,0,static_cast<uint32_t>(payload.size())};
+    write_block_header(destination,header);
+    destination.insert(destination.end(),payload.begin(),payload.end());
+}
+
+bool create_archive(const std::vector<std::string>& files,std::ostream& output_file,const block_options& options){
+    std::vector<unsigned char> file_header(ARCHIVE_MAGIC_NUMBER,ARCHIVE_MAGIC_NUMBER + 4);
+    file_header.push_back(BLOCK_FORMAT_VERSION);
+    file_header.push_back(options.checksums);
+    put_u32(file_header,options.block_size);
+    output_file.write(reinterpret_cast<const char*>(file_header.data()),file_header.size());
+
+    uint64_t block_size = options.block_size;
+    std::vector<archive_member> members(files.size());
+    //The blocks are written by whichever thread finishes them, one at a time, at the position in offset.
+    std::mutex output_mutex;
+    uint64_t offset = FILE_HEADER_SIZE;
+    std::atomic<bool> failed(false);
+    {
+        work_stealing_pool pool(options.threads);
+        for(size_t file = 0;file < files.size();++file){
+            pool.submit([&,file]{
+                //The mapping is shared by the tasks of the file's blocks, and unmapped when the last one is done.
+                std::shared_ptr<mapped_file> input_map(new mapped_file);
+                if(!input_map->open(files[file].c_str())){
+                    std::lock_guard<std::mutex> lock(output_mutex);
+                    std::cerr << "Cannot read file " << files[file] << std::endl;
+                    failed = true;
+                    return;
+                }
+                archive_member& member = members[file];
+                member.path = files[file];
+                member.size = input_map->size();
+                member.blocks.resize((member.size + block_size - 1) / block_size);
+                for(size_t block = 0;block < member.blocks.size();++block){
+                    pool.submit([&,input_map,file,block]{
+                        uint64_t start = block * block_size;
+                        size_t size = std::min(block_size,members[file].size - start);
+                        std::vector<unsigned char> compressed;
+                        encode_block(input_map->data() + start,size,compressed,options);
+                        std::lock_guard<std::mutex> lock(output_mutex);
+                        members[file].blocks[block] = offset;
+                        output_file.write(reinterpret_cast<const char*>(compressed.data()),compressed.size());
+                        offset += compressed.size();
+                    });
+                }
+            });
+        }
+        pool.wait();
+    }
+    if(failed)
+        return false;
+    std::vector<unsigned char> trailer;
+    write_archive_index(trailer,members);
+    write_end_block(trailer,offset);
+    output_file.write(reinterpret_cast<const char*>(trailer.data()),trailer.size());
+    return static_cast<bool>(output_file);
+}
+
+bool read_archive_index(const unsigned char* data,size_t size,uint32_t& block_size,unsigned char& flags,
+        std::vector<archive_member>& members){
+    const unsigned char* end = data + size;
+    if(size < FILE_HEADER_SIZE + END_BLOCK_SIZE || memcmp(data,ARCHIVE_MAGIC_NUMBER,4) != 0 ||
+            data[4] != BLOCK_FORMAT_VERSION || (data[5] & ~KNOWN_FLAGS) != 0)
+        return false;
+    flags = data[5];
+    block_size = get_u32(data + 6);
+    if(block_size == 0)
+        return false;
+    //The end block holds the position of the member index.
+    block_header header;
+    const unsigned char* position = read_block_header(end - END_BLOCK_SIZE,end,header);
+    if(header.type != END_BLOCK || header.payload_size != 8)
+        return false;
+    uint64_t index_offset = get_u64(position);
+    if(index_offset < FILE_HEADER_SIZE || index_offset > size - END_BLOCK_SIZE)
+        return false;
+    position = read_block_header(data + index_offset,end - END_BLOCK_SIZE,header);
+    if(!position || header.type != FILE_INDEX_BLOCK ||
+            header.payload_size > static_cast<size_t>(end - END_BLOCK_SIZE - position))
+        return false;
+    const unsigned char* index_end = position + header.payload_size;
+    uint64_t count;
+    if(!(position = read_number(position,index_end,count)) || count > header.payload_size)
+        return false;
+    members.resize(count);
+    for(auto& member:members){
+        uint64_t path_size;
+        uint64_t blocks;
+        if(!(position = read_number(position,index_end,path_size)) ||
+                path_size > static_cast<size_t>(index_end - position))
+            return false;
+        member.path.assign(reinterpret_cast<const char*>(position),path_size);
+        position += path_size;
+        if(!(position = read_number(position,index_end,member.size)) ||
+                !(position = read_number(position,index_end,blocks)) ||
+                blocks != (member.size + block_size - 1) / block_size ||
+                blocks > static_cast<size_t>(index_end - position))
+            return false;
+        member.blocks.resize(blocks);
+        for(auto& offset:member.blocks){
+            if(!(position = read_number(position,index_end,offset)) || offset >= index_offset)
+                return false;
+        }
+    }
+    return position == index_end;
+}
+
+bool extract_member(const unsigned char* data,size_t size,uint32_t block_size,unsigned char flags,
+        const archive_member& member,std::ostream& output_file,unsigned threads){
+    thread_pool pool(threads);
+    size_t batch_size = pool.size() * 2;
+    std::vector<std::vector<unsigned char> > outputs(batch_size);
+    //vector<bool> is not used since its elements cannot be written by different threads at the same time.
+    std::vector<char> decoded(batch_size);
+    for(size_t first = 0;first < member.blocks.size();first += batch_size){
+        size_t blocks = std::min(batch_size,member.blocks.size() - first);
+        for(size_t block = 0;block < blocks;++block){
+            uint64_t start = (first + block) * static_cast<uint64_t>(block_size);
+            outputs[block].resize(std::min<uint64_t>(block_size,member.size - start));
+            pool.submit([&,first,block]{
+                block_header header;
+                const unsigned char* payload = read_block_header(data + member.blocks[first + block],data + size,
+                    header);
+                decoded[block] = payload && header.raw_size == outputs[block].size() &&
+                    header.payload_size <= static_cast<size_t>(data + size - payload) &&
+                    holds_data(header.type) &&
+                    decode_block(flags,header.type,payload,header.payload_size,outputs[block].data(),
+                        outputs[block].size());
+            });
+        }
+        pool.wait();
+        for(size_t block = 0;block < blocks;++block){
+            if(!decoded[block])
+                return false;
+            output_file.write(reinterpret_cast<const char*>(outputs[block].data()),outputs[block].size());
+        }
+    }
+    return true;
+}
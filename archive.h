@@ -0,0 +1,49 @@
+/*
+This file contains the functions that create and read archives, which hold many files in one container.  An archive
+has the same header as a file compressed in blocks (see block_format.h) but its own magic number, followed by the
+blocks of every member, a member index block, and an end block holding the position of the member index.  Each
+member is split into blocks of the size in the header, which are compressed by encode_block and decoded by
+decode_block like the blocks of a single file.
+
+The files, and the blocks of each file, are compressed on a work_stealing_pool: a task for each file maps it and
+submits a task for each of its blocks, so the blocks of a large file are spread between the threads that are done
+with their small files.  Blocks are written in the order in which they finish, which does not depend on their order
+in the files, so the member index lists where each block of each member is.  That also lets a single member be
+extracted by decoding only its own blocks.
+*/
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "block_codec.h"
+
+const char ARCHIVE_MAGIC_NUMBER[] = "hufa";
+
+struct archive_member{
+    //The path of the file, as it was given when the archive was created.
+    std::string path;
+    //The number of bytes in the file.
+    uint64_t size;
+    //The position of the header of each of the file's blocks in the archive, in the order of the file.
+    std::vector<uint64_t> blocks;
+};
+
+//Appends the regular files at the path to the list.  If the path is a directory, the files under it are added,
+//sorted by name.  Returns false if the path does not exist or is neither a regular file nor a directory.
+bool collect_files(const std::string& path,std::vector<std::string>& files);
+//Compresses the files into an archive, with the block size, the number of threads, the length limit and the number
+//of bitstreams in the options.  Returns false, after reporting the file on the error stream, if a file cannot be
+//read.
+bool create_archive(const std::vector<std::string>& files,std::ostream& output_file,const block_options& options);
+//Reads the block size, the flags and the member index of the archive in the buffer.  Returns false if the archive is
+//corrupt.
+bool read_archive_index(const unsigned char* data,size_t size,uint32_t& block_size,unsigned char& flags,
+    std::vector<archive_member>& members);
+//Decompresses a single member of the archive in the buffer to the output, decoding its blocks on the given number
+//of threads and verifying the checksums that the flags call for.  Returns false if the member's blocks are corrupt.
+bool extract_member(const unsigned char* data,size_t size,uint32_t block_size,unsigned char flags,
+    const archive_member& member,std::ostream& output_file,unsigned threads);
+
+#endif // ARCHIVE_H_
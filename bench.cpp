@@ -0,0 +1,336 @@
+/*
+ Contains the benchmark that is built and run by make bench.  It generates a set of synthetic corpora and times each
+stage of compressing and decompressing them on their own:
+1) histogram: counting the characters with the histogram class
+2) create_encoding: computing the lengths of the bitstrings with a code_builder and building the encode_table
+3) write_table and read_table: writing the table of lengths with write_lengths and reading it back with read_lengths
+4) encode: encoding the characters into a buffer with an obitstream
+5) encode_streams: dealing the characters to four bitstreams and encoding them with encode_streams
+6) build_decoder: building the decode_table
+7) decode: decoding the characters of the single bitstream with an ibitstream
+8) decode_streams: decoding the four bitstreams side by side with decode_streams
+
+The corpora are generated from a fixed seed by a generator that is part of this file, so every run (and every commit)
+measures the same bytes.  Each stage is repeated until it has taken a minimum amount of time, and the fastest of
+several such rounds is reported, which hides most of the noise from other processes.  The results are printed as a
+table, and, with --json file, also written as JSON so that runs of different commits can be compared by a script.
+*/
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "block_codec.h"
+#include "code_builder.h"
+#include "cpu_dispatch.h"
+#include "decode_table.h"
+#include "encode_table.h"
+#include "encoding_table.h"
+#include "histogram.h"
+#include "ibitstream.h"
+#include "obitstream.h"
+#include "type_defs.h"
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+//The size of each corpus, other than the tiny one.
+const size_t CORPUS_SIZE = 4 << 20;
+//The size of the tiny corpus, which measures the fixed cost of each stage rather than its throughput.
+const size_t TINY_SIZE = 64;
+//Each stage is repeated until a round takes this long.
+const double MIN_ROUND_SECONDS = 0.05;
+//The number of rounds of each stage, of which the fastest is reported.
+const unsigned ROUNDS = 5;
+//The number of bitstreams that the multi-stream stages deal the characters to, which is the number that decoding
+//unrolls.
+const unsigned BENCH_STREAMS = 4;
+
+//A xorshift generator.  std::mt19937 would do as well, but the distributions of the standard library may differ
+//between implementations, and the corpora should not.
+class random_bytes{
+public:
+    explicit random_bytes(uint64_t seed)
+        :state(seed)
+        {}
+    uint64_t next(){
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+    //Returns a number that is uniformly distributed between 0 and 1.
+    double uniform(){
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t state;
+};
+
+struct corpus{
+    string name;
+    vector<unsigned char> data;
+};
+
+//Every byte is equally likely, so the data cannot be compressed.
+static vector<unsigned char> uniform_corpus(size_t size,random_bytes& generator){
+    vector<unsigned char> data(size);
+    for(auto& byte:data){
+        byte = generator.next();
+    }
+    return data;
+}
+
+//Bytes with a geometric distribution, so that a few characters are very common and the rest have long bitstrings.
+static vector<unsigned char> skewed_corpus(size_t size,random_bytes& generator){
+    vector<unsigned char> data(size);
+    for(auto& byte:data){
+        byte = std::min(255.0,-std::log(1 - generator.uniform()) * 12);
+    }
+    return data;
+}
+
+//Words drawn from a list with a Zipf distribution, separated by spaces and some punctuation, which has roughly the
+//character frequencies of English text.
+static vector<unsigned char> text_corpus(size_t size,random_bytes& generator){
+    const char* words[] = {"the","of","and","to","a","in","is","it","that","was","he","for","on","are","with","as",
+        "his","they","be","at","one","have","this","from","or","had","by","word","but","what","some","we","can","out",
+        "other","were","all","there","when","up","use","your","how","said","an","each","she","which","do","their",
+        "time","if","will","way","about","many","then","them","would","write","like","so","these","her","long","make",
+        "thing","see","him","two","has","look","more","day","could","go","come","did","number","sound","no","most",
+        "people","my","over","know","water","than","call","first","who","may","down","side","been","now","find"};
+    const size_t WORDS = sizeof(words) / sizeof(words[0]);
+    //The cumulative weights of the words, where the weight of the n-th word is 1/(n+1).
+    vector<double> cumulative(WORDS);
+    double total = 0;
+    for(size_t word = 0;word < WORDS;++word){
+        total += 1.0 / (word + 1);
+        cumulative[word] = total;
+    }
+    vector<unsigned char> data;
+    data.reserve(size + 16);
+    bool sentence_start = true;
+    while(data.size() < size){
+        double pick = generator.uniform() * total;
+        size_t word = std::lower_bound(cumulative.begin(),cumulative.end(),pick) - cumulative.begin();
+        size_t start = data.size();
+        data.insert(data.end(),words[word],words[word] + strlen(words[word]));
+        if(sentence_start)
+            data[start] = toupper(data[start]);
+        uint64_t punctuation = generator.next() % 16;
+        sentence_start = punctuation == 0;
+        if(punctuation == 0)
+            data.push_back('.');
+        else if(punctuation == 1)
+            data.push_back(',');
+        data.push_back(generator.next() % 12 == 0 ? '\n' : ' ');
+    }
+    data.resize(size);
+    return data;
+}
+
+//Records of little-endian integers and floating point numbers, like the contents of an executable or a database.
+static vector<unsigned char> binary_corpus(size_t size,random_bytes& generator){
+    vector<unsigned char> data;
+    data.reserve(size + 16);
+    while(data.size() < size){
+        uint32_t integer = generator.next() % 1000;
+        float number = static_cast<float>(generator.uniform() * 100);
+        unsigned char record[12];
+        memcpy(record,&integer,4);
+        memcpy(record + 4,&number,4);
+        memset(record + 8,0,4);
+        record[8] = generator.next() % 4;
+        data.insert(data.end(),record,record + sizeof(record));
+    }
+    data.resize(size);
+    return data;
+}
+
+static vector<corpus> make_corpora(){
+    random_bytes generator(0x9e3779b97f4a7c15ULL);
+    vector<corpus> corpora;
+    corpora.push_back({"uniform",uniform_corpus(CORPUS_SIZE,generator)});
+    corpora.push_back({"skewed",skewed_corpus(CORPUS_SIZE,generator)});
+    corpora.push_back({"text",text_corpus(CORPUS_SIZE,generator)});
+    corpora.push_back({"binary",binary_corpus(CORPUS_SIZE,generator)});
+    corpora.push_back({"one_byte",vector<unsigned char>(CORPUS_SIZE,'a')});
+    corpora.push_back({"tiny",text_corpus(TINY_SIZE,generator)});
+    return corpora;
+}
+
+//Returns the fastest time, in seconds, that one run of the stage took.
+static double time_stage(const std::function<void()>& stage){
+    typedef std::chrono::steady_clock clock;
+    double best = 1e30;
+    for(unsigned round = 0;round < ROUNDS;++round){
+        size_t runs = 0;
+        auto start = clock::now();
+        double elapsed;
+        do{
+            stage();
+            ++runs;
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        }while(elapsed < MIN_ROUND_SECONDS);
+        best = std::min(best,elapsed / runs);
+    }
+    return best;
+}
+
+struct stage_result{
+    const char* name;
+    double seconds;
+};
+
+struct corpus_result{
+    string name;
+    size_t size;
+    size_t compressed_size;
+    vector<stage_result> stages;
+};
+
+//Keeps the compiler from discarding the result of a stage that is otherwise unused.
+static volatile uint64_t sink;
+
+static corpus_result run_corpus(const corpus& input){
+    const unsigned char* data = input.data.data();
+    size_t size = input.data.size();
+    corpus_result result = {input.name,size,0,{}};
+
+    //Each stage works on the output of the ones before it, which is computed once outside of the timed code.
+    histogram counts;
+    code_builder builder;
+    code_lengths lengths;
+    encode_table encoder;
+    decode_table decoder;
+    vector<unsigned char> table;
+    vector<unsigned char> bits;
+    vector<unsigned char> stream_bits;
+    vector<unsigned char> output(size);
+    vector<unsigned char> stream_output(size);
+
+    result.stages.push_back({"histogram",time_stage([&]{
+        counts = histogram();
+        counts.add(data,size);
+        sink = counts.total();
+    })});
+    result.stages.push_back({"create_encoding",time_stage([&]{
+        builder.build(counts.frequencies(),DEFAULT_MAX_CODE_LENGTH,lengths);
+        encoder.build(lengths);
+        sink = encoder.max_length();
+    })});
+    result.stages.push_back({"write_table",time_stage([&]{
+        table.clear();
+        write_lengths(table,lengths);
+        sink = table.size();
+    })});
+    result.stages.push_back({"read_table",time_stage([&]{
+        code_lengths read;
+        sink = read_lengths(table.data(),table.data() + table.size(),read) - table.data();
+    })});
+    result.stages.push_back({"encode",time_stage([&]{
+        bits.clear();
+        obitstream stream(bits);
+        stream.encode(encoder,data,size);
+        stream.flush();
+    })});
+    result.stages.push_back({"encode_streams",time_stage([&]{
+        stream_bits.clear();
+        encode_streams(encoder,data,size,BENCH_STREAMS,stream_bits);
+    })});
+    result.stages.push_back({"build_decoder",time_stage([&]{
+        decoder.build(lengths);
+        sink = decoder.max_length();
+    })});
+    bool valid = true;
+    result.stages.push_back({"decode",time_stage([&]{
+        ibitstream stream(bits.data(),bits.size());
+        valid = stream.decode(decoder,output.data(),size) == size;
+    })});
+    bool streams_valid = true;
+    result.stages.push_back({"decode_streams",time_stage([&]{
+        streams_valid = decode_streams(decoder,stream_bits.data(),stream_bits.data() + stream_bits.size(),
+            stream_output.data(),size);
+    })});
+    if(!valid || output != input.data || !streams_valid || stream_output != input.data){
+        cerr << "The " << input.name << " corpus did not decode to itself." << endl;
+        exit(1);
+    }
+    result.compressed_size = table.size() + bits.size();
+    return result;
+}
+
+static void print_table(const vector<corpus_result>& results){
+    printf("%-10s %-16s %10s %10s %8s\n","corpus","stage","MB/s","ns/byte","ratio");
+    for(auto& result:results){
+        double ratio = static_cast<double>(result.compressed_size) / result.size;
+        for(auto& stage:result.stages){
+            printf("%-10s %-16s %10.1f %10.3f %8.4f\n",result.name.c_str(),stage.name,
+                result.size / stage.seconds / 1e6,stage.seconds * 1e9 / result.size,ratio);
+        }
+    }
+}
+
+static bool write_json(const char* file_name,const vector<corpus_result>& results){
+    std::ofstream output(file_name);
+    output << "{\n  \"variant\": \"" << variant_name(active_variant()) << "\",\n  \"corpora\": [\n";
+    for(size_t corpus = 0;corpus < results.size();++corpus){
+        auto& result = results[corpus];
+        output << "    {\"name\": \"" << result.name << "\", \"size\": " << result.size
+            << ", \"compressed_size\": " << result.compressed_size
+            << ", \"ratio\": " << static_cast<double>(result.compressed_size) / result.size << ", \"stages\": {";
+        for(size_t stage = 0;stage < result.stages.size();++stage){
+            auto& timing = result.stages[stage];
+            output << (stage ? ", " : "") << "\"" << timing.name << "\": {\"seconds\": " << timing.seconds
+                << ", \"mb_per_s\": " << result.size / timing.seconds / 1e6
+                << ", \"ns_per_byte\": " << timing.seconds * 1e9 / result.size << "}";
+        }
+        output << "}}" << (corpus + 1 < results.size() ? "," : "") << "\n";
+    }
+    output << "  ]\n}\n";
+    return static_cast<bool>(output);
+}
+
+int main(int argc,char* argv[]){
+    const char* json_file = nullptr;
+    bool valid = true;
+    for(int arg = 1;arg < argc && valid;++arg){
+        cpu_variant variant;
+        if(strcmp(argv[arg],"--json") == 0 && arg + 1 < argc){
+            json_file = argv[++arg];
+        }else if(strcmp(argv[arg],"--cpu") == 0 && arg + 1 < argc){
+            valid = parse_variant(argv[++arg],variant);
+            if(valid && !force_variant(variant)){
+                cerr << "This processor does not support the " << argv[arg] << " variant." << endl;
+                return 1;
+            }
+        }else{
+            valid = false;
+        }
+    }
+    if(!valid){
+        cerr << "Expected usage: ./huffman_bench [--json output_file] [--cpu scalar | bmi2 | avx2]" << endl;
+        return 1;
+    }
+    printf("Running the %s variant of the kernels.\n",variant_name(active_variant()));
+    vector<corpus_result> results;
+    for(auto& input:make_corpora()){
+        results.push_back(run_corpus(input));
+    }
+    print_table(results);
+    if(json_file && !write_json(json_file,results)){
+        cerr << "Cannot write file " << json_file << endl;
+        return 1;
+    }
+    return 0;
+}
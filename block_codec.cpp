@@ -0,0 +1,538 @@
+#include "block_codec.h"
+#include <algorithm>
+#include <cstring>
+#include "block_format.h"
+#include "code_builder.h"
+#include "crc32c.h"
+#include "create_encoding.h"
+#include "decode_table.h"
+#include "encode_table.h"
+#include "encoding_table.h"
+#include "histogram.h"
+#include "ibitstream.h"
+#include "obitstream.h"
+#include "thread_pool.h"
+
+void encode_streams(const encode_table& table,const unsigned char* data,size_t size,unsigned streams,
+        std::vector<unsigned char>& destination){
+    destination.push_back(streams);
+    //The size of each bitstream but the last is filled in once it is encoded.
+    size_t jump_table = destination.size();
+    destination.resize(jump_table + 4 * (streams - 1));
+    //Gather the characters of each bitstream, which are every streams-th character of the block, and encode them.
+    std::vector<unsigned char> stream_data((size + streams - 1) / streams);
+    for(unsigned stream = 0;stream < streams;++stream){
+        size_t count = 0;
+        for(size_t position = stream;position < size;position += streams){
+            stream_data[count++] = data[position];
+        }
+        size_t start = destination.size();
+        obitstream bits_stream(destination);
+        bits_stream.encode(table,stream_data.data(),count);
+        bits_stream.flush();
+        if(stream + 1 < streams)
+            set_u32(destination.data() + jump_table + 4 * stream,destination.size() - start);
+    }
+}
+
+void encode_block(const unsigned char* data,size_t size,std::vector<unsigned char>& destination,
+        const block_options& options,std::vector<uint64_t>* checkpoints,limit_cost* cost){
+    //Count the frequency of each character in the block.
+    histogram frequencies;
+    frequencies.add(data,size);
+
+    //The payload is encoded directly after the header, which is filled in once the payload's size is known.
+    size_t header_offset = destination.size();
+    size_t payload_offset = header_offset + BLOCK_HEADER_SIZE;
+    destination.resize(payload_offset);
+    unsigned streams = std::max(1u,options.streams);
+    //The encoding is only built if the entropy of the block says that one could save enough, and only used if it does
+    //save enough along with its table.  Otherwise the block is stored, which costs a copy to encode and to decode.
+    bool encode = frequencies.worth_encoding(frequencies.entropy_bits() / 8);
+    encode_table table;
+    if(encode){
+        //Each thread keeps its own builder, which needs no memory beyond its arrays.
+        static thread_local code_builder builder;
+        code_lengths lengths;
+        limit_cost block_cost = {0,0};
+        builder.build(frequencies.frequencies(),options.max_code_length,lengths,&block_cost);
+        write_lengths(destination,lengths);
+        size_t overhead = destination.size() - payload_offset + (streams == 1 ? 0 : 1 + 4 * (streams - 1));
+        encode = frequencies.worth_encoding(overhead + block_cost.limited_bits / 8.0);
+        if(encode){
+            table.build(lengths);
+            if(cost){
+                cost->optimal_bits += block_cost.optimal_bits;
+                cost->limited_bits += block_cost.limited_bits;
+            }
+        }else{
+            destination.resize(payload_offset);
+        }
+    }
+    if(!encode){
+        destination.insert(destination.end(),data,data + size);
+    }else if(streams == 1){
+        uint64_t table_bits = (destination.size() - payload_offset) * 8;
+        obitstream bits_stream(destination);
+        if(checkpoints && options.index_interval != 0){
+            //Encode one interval at a time, recording the position in the payload at the start of each one after
+            //the first.
+            uint32_t interval = options.index_interval;
+            for(size_t position = 0;position < size;position += interval){
+                if(position != 0)
+                    checkpoints->push_back(table_bits + bits_stream.tell());
+                bits_stream.encode(table,data + position,std::min<size_t>(interval,size - position));
+            }
+        }else{
+            bits_stream.encode(table,data,size);
+        }
+        bits_stream.flush();
+    }else{
+        encode_streams(table,data,size,streams,destination);
+    }
+
+    if(options.checksums & DATA_CRC_FLAG)
+        put_u32(destination,crc32c(data,size));
+    if(options.checksums & PAYLOAD_CRC_FLAG)
+        put_u32(destination,crc32c(destination.data() + payload_offset,destination.size() - payload_offset));
+    uint32_t payload_size = destination.size() - payload_offset;
+    unsigned char type = !encode ? STORED_BLOCK : streams == 1 ? HUFFMAN_BLOCK : MULTI_STREAM_BLOCK;
+    block_header header = {type,static_cast<uint32_t>(size),payload_size};
+    std::vector<unsigned char> header_bytes;
+    write_block_header(header_bytes,header);
+    std::copy(header_bytes.begin(),header_bytes.end(),destination.begin() + header_offset);
+}
+
+//Decodes the characters of a block that were dealt to several bitstreams, taking one character from each bitstream
+//in turn.  The bitstreams do not depend on each other, so the processor can decode from all of them at once.
+static bool decode_interleaved(const decode_table& table,std::vector<ibitstream>& streams,unsigned char* output,
+        size_t raw_size){
+    size_t count = streams.size();
+    //The common case has a kernel that keeps the state of each bitstream in registers.
+    if(count == ibitstream::INTERLEAVED_STREAMS)
+        return ibitstream::decode_interleaved(table,streams.data(),output,raw_size) == raw_size;
+    size_t position = 0;
+    for(;raw_size - position >= count;position += count){
+        for(size_t stream = 0;stream < count;++stream){
+            int current_char = streams[stream].decode(table);
+            if(current_char < 0)
+                return false;
+            output[position + stream] = current_char;
+        }
+    }
+    for(size_t stream = 0;position < raw_size;++position,++stream){
+        int current_char = streams[stream].decode(table);
+        if(current_char < 0)
+            return false;
+        output[position] = current_char;
+    }
+    return true;
+}
+
+bool decode_streams(const decode_table& table,const unsigned char* bits,const unsigned char* end,unsigned char* output,
+        size_t raw_size){
+    if(bits == end || *bits < 2 || *bits > MAX_STREAMS)
+        return false;
+    unsigned count = *bits++;
+    if(static_cast<size_t>(end - bits) < 4 * (count - 1))
+        return false;
+    const unsigned char* jump_table = bits;
+    bits += 4 * (count - 1);
+    std::vector<ibitstream> streams;
+    streams.reserve(count);
+    for(unsigned stream = 0;stream < count;++stream){
+        size_t size = stream + 1 < count ? get_u32(jump_table + 4 * stream) : end - bits;
+        if(size > static_cast<size_t>(end - bits))
+            return false;
+        streams.emplace_back(bits,size);
+        bits += size;
+    }
+    return decode_interleaved(table,streams,output,raw_size);
+}
+
+//Decodes the payload of a block, without its checksums.
+static bool decode_payload(unsigned char type,const unsigned char* payload,size_t payload_size,unsigned char* output,
+        size_t raw_size){
+    if(type == STORED_BLOCK){
+        if(payload_size != raw_size)
+            return false;
+        memcpy(output,payload,raw_size);
+        return true;
+    }
+    const unsigned char* end = payload + payload_size;
+    code_lengths lengths;
+    const unsigned char* bits = read_lengths(payload,end,lengths);
+    if(!bits)
+        return false;
+    decode_table table(lengths);
+    if(type == MULTI_STREAM_BLOCK)
+        return decode_streams(table,bits,end,output,raw_size);
+    ibitstream bits_stream(bits,end - bits);
+    return bits_stream.decode(table,output,raw_size) == raw_size;
+}
+
+bool decode_block(unsigned char flags,unsigned char type,const unsigned char* payload,size_t payload_size,
+        unsigned char* output,size_t raw_size){
+    if(payload_size < checksums_size(flags))
+        return false;
+    //The checksum of the payload is checked first, so that a corrupt block is not decoded at all.
+    if(flags & PAYLOAD_CRC_FLAG){
+        payload_size -= 4;
+        if(crc32c(payload,payload_size) != get_u32(payload + payload_size))
+            return false;
+    }
+    if(flags & DATA_CRC_FLAG)
+        payload_size -= 4;
+    if(!decode_payload(type,payload,payload_size,output,raw_size))
+        return false;
+    return !(flags & DATA_CRC_FLAG) || crc32c(output,raw_size) == get_u32(payload + payload_size);
+}
+
+//Where write_blocks starts writing blocks.
+struct block_start{
+    //The position of the first block in the original file and in the compressed file.
+    uint64_t raw_offset;
+    uint64_t file_offset;
+    //The position of the directory of the blocks before the first one, or 0.
+    uint64_t previous;
+    //The blocks before the first one that the directory should list, since no directory lists them.
+    std::vector<directory_entry> directory;
+};
+
+//Writes the header of a file of blocks, after the magic number.
+static void write_file_header(std::ostream& output_file,const block_options& options,job_stats* stats){
+    std::vector<unsigned char> file_header;
+    file_header.push_back(BLOCK_FORMAT_VERSION);
+    file_header.push_back(options.checksums);
+    put_u32(file_header,options.block_size);
+    output_file.write(reinterpret_cast<const char*>(file_header.data()),file_header.size());
+    if(stats)
+        stats->set_header_size(FILE_HEADER_SIZE);
+}
+
+//Compresses the input in blocks, followed by the directory and the end block.  The input is read from input_file, or,
+//if it is nullptr, taken from the buffer.  Each batch is timed as a whole, since its blocks are counted, built and
+//encoded on different threads at the same time.
+static limit_cost write_blocks(std::istream* input_file,const unsigned char* data,size_t size,std::ostream& output_file,
+        const block_options& options,const block_start& start,job_stats* stats){
+    //The positions are counted rather than asked from the stream, since the output may not be seekable.
+    uint64_t raw_offset = start.raw_offset;
+    uint64_t file_offset = start.file_offset;
+    std::vector<directory_entry> directory(start.directory);
+
+    thread_pool pool(options.threads);
+    //Read enough blocks at a time to keep every thread busy.
+    size_t batch_size = pool.size() * 2;
+    //The data of each block in the batch.  Blocks that are read from a stream are stored in inputs; blocks of a
+    //buffer are compressed where they are.
+    std::vector<std::vector<unsigned char> > inputs(input_file ? batch_size : 0);
+    std::vector<const unsigned char*> block_data(batch_size);
+    std::vector<size_t> block_sizes(batch_size);
+    std::vector<std::vector<unsigned char> > outputs(batch_size);
+    bool indexed = options.directory && options.index_interval != 0;
+    //The checkpoints of every block in the directory, and of each block in the batch.
+    std::vector<std::vector<uint64_t> > index(indexed ? directory.size() : 0);
+    std::vector<std::vector<uint64_t> > checkpoints(batch_size);
+    limit_cost total_cost = {0,0};
+    std::vector<limit_cost> costs(batch_size);
+    size_t position = 0;
+    bool more = true;
+    while(more){
+        size_t blocks = 0;
+        while(more && blocks < batch_size){
+            if(input_file){
+                auto& input = inputs[blocks];
+                input.resize(options.block_size);
+                input_file->read(reinterpret_cast<char*>(input.data()),input.size());
+                input.resize(input_file->gcount());
+                block_data[blocks] = input.data();
+                block_sizes[blocks] = input.size();
+                //A block that is not full is the last one.
+                more = input.size() == options.block_size;
+            }else{
+                block_data[blocks] = data + position;
+                block_sizes[blocks] = std::min<size_t>(options.block_size,size - position);
+                position += block_sizes[blocks];
+                more = position < size;
+            }
+            if(block_sizes[blocks] != 0)
+                ++blocks;
+        }
+        if(stats)
+            stats->start(CODE_PHASE);
+        uint64_t batch_bytes = 0;
+        for(size_t block = 0;block < blocks;++block){
+            batch_bytes += block_sizes[block];
+            outputs[block].clear();
+            checkpoints[block].clear();
+            costs[block] = limit_cost{0,0};
+            pool.submit([&block_data,&block_sizes,&outputs,&checkpoints,&costs,&options,indexed,block]{
+                encode_block(block_data[block],block_sizes[block],outputs[block],options,
+                    indexed ? &checkpoints[block] : nullptr,&costs[block]);
+            });
+        }
+        pool.wait();
+        if(stats){
+            stats->stop(CODE_PHASE,batch_bytes);
+            stats->start(WRITE_PHASE);
+        }
+        uint64_t batch_start = file_offset;
+        //Write the blocks in the order in which they were read.
+        for(size_t block = 0;block < blocks;++block){
+            if(options.directory){
+                directory_entry entry = {raw_offset,file_offset};
+                directory.push_back(entry);
+            }
+            if(indexed)
+                index.push_back(checkpoints[block]);
+            total_cost.optimal_bits += costs[block].optimal_bits;
+            total_cost.limited_bits += costs[block].limited_bits;
+            raw_offset += block_sizes[block];
+            file_offset += outputs[block].size();
+            output_file.write(reinterpret_cast<const char*>(outputs[block].data()),outputs[block].size());
+        }
+        output_file.flush();
+        if(stats)
+            stats->stop(WRITE_PHASE,file_offset - batch_start);
+    }
+
+    std::vector<unsigned char> trailer;
+    uint64_t directory_offset = 0;
+    if(options.directory){
+        directory_offset = file_offset;
+        write_directory(trailer,directory,start.previous);
+        if(indexed)
+            write_index(trailer,options.index_interval,index);
+    }
+    write_end_block(trailer,directory_offset);
+    output_file.write(reinterpret_cast<const char*>(trailer.data()),trailer.size());
+    return total_cost;
+}
+
+limit_cost compress_blocks(std::istream& input_file,std::ostream& output_file,const block_options& options,
+        job_stats* stats){
+    write_file_header(output_file,options,stats);
+    block_start start = {0,FILE_HEADER_SIZE,0,{}};
+    return write_blocks(&input_file,nullptr,0,output_file,options,start,stats);
+}
+
+limit_cost compress_blocks(const unsigned char* data,size_t size,std::ostream& output_file,
+        const block_options& options,job_stats* stats){
+    write_file_header(output_file,options,stats);
+    block_start start = {0,FILE_HEADER_SIZE,0,{}};
+    return write_blocks(nullptr,data,size,output_file,options,start,stats);
+}
+
+//Reads the header of the block at the position in the file.
+static bool read_block_header_at(std::istream& file,uint64_t position,block_header& header){
+    file.seekg(position,std::ios::beg);
+    return read_block_header(file,header);
+}
+
+//Finds where the blocks that are appended to the file start, which is the end of the file, and the position in the
+//original file that they continue from.  The block size and the checksums of the file are copied to the options.
+//Only the headers and the end of the file are read, except in a file without a directory.
+static bool find_append_start(std::istream& file,block_options& options,block_start& start){
+    unsigned char file_header[FILE_HEADER_SIZE];
+    file.seekg(0,std::ios::beg);
+    file.read(reinterpret_cast<char*>(file_header),FILE_HEADER_SIZE);
+    if(!file || memcmp(file_header,BLOCK_MAGIC_NUMBER,4) != 0 || file_header[4] != BLOCK_FORMAT_VERSION ||
+            (file_header[5] & ~KNOWN_FLAGS) != 0)
+        return false;
+    options.checksums = file_header[5];
+    options.block_size = get_u32(file_header + 6);
+    options.directory = true;
+
+    file.seekg(0,std::ios::end);
+    uint64_t file_size = file.tellg();
+    if(options.block_size == 0 || file_size < FILE_HEADER_SIZE + END_BLOCK_SIZE)
+        return false;
+    uint64_t end_offset = file_size - END_BLOCK_SIZE;
+    block_header header;
+    unsigned char number[8];
+    if(!read_block_header_at(file,end_offset,header) || header.type != END_BLOCK || header.payload_size != 8 ||
+            !file.read(reinterpret_cast<char*>(number),8))
+        return false;
+    start.raw_offset = 0;
+    start.file_offset = file_size;
+    start.previous = get_u64(number);
+    start.directory.clear();
+
+    //A file without a directory is read a block header at a time, and the directory of the appended blocks lists
+    //its blocks too, so that later appends find a directory.
+    if(start.previous == 0){
+        uint64_t position = FILE_HEADER_SIZE;
+        while(position < end_offset){
+            if(!read_block_header_at(file,position,header) || header.type == END_BLOCK)
+                return false;
+            if(holds_data(header.type)){
+                directory_entry entry = {start.raw_offset,position};
+                start.directory.push_back(entry);
+                start.raw_offset += header.raw_size;
+            }
+            position += BLOCK_HEADER_SIZE + header.payload_size;
+        }
+        return position == end_offset;
+    }
+    //Otherwise the data ends with the last entry of the latest directory that has any, whose block's header holds
+    //its size.  A directory is empty only if nothing was appended, so this is almost always the last directory.
+    uint64_t directory = start.previous;
+    while(directory != 0){
+        if(!read_block_header_at(file,directory,header) || header.type != DIRECTORY_BLOCK ||
+                header.payload_size < 16 || header.payload_size % 16 != 0 ||
+                !file.read(reinterpret_cast<char*>(number),8))
+            return false;
+        uint64_t previous = get_u64(number);
+        if(header.payload_size > 16){
+            unsigned char entry[16];
+            file.seekg(directory + BLOCK_HEADER_SIZE + header.payload_size - 16,std::ios::beg);
+            file.read(reinterpret_cast<char*>(entry),16);
+            if(!file || !read_block_header_at(file,get_u64(entry + 8),header) || !holds_data(header.type))
+                return false;
+            start.raw_offset = get_u64(entry) + header.raw_size;
+            return true;
+        }
+        if(previous >= directory)
+            return false;
+        directory = previous;
+    }
+    return true;
+}
+
+//Appends the input to the file.  The input is read from input_file, or, if it is nullptr, taken from the buffer.
+static bool append_blocks(std::istream* input_file,const unsigned char* data,size_t size,std::iostream& file,
+        block_options options){
+    block_start start;
+    if(!find_append_start(file,options,start))
+        return false;
+    //The new blocks are written after the end block, which is left as it is, so the file is never without one.
+    file.clear();
+    file.seekp(start.file_offset,std::ios::beg);
+    write_blocks(input_file,data,size,file,options,start,nullptr);
+    file.flush();
+    return static_cast<bool>(file);
+}
+
+bool append_blocks(std::istream& input_file,std::iostream& file,const block_options& options){
+    return append_blocks(&input_file,nullptr,0,file,options);
+}
+
+bool append_blocks(const unsigned char* data,size_t size,std::iostream& file,const block_options& options){
+    return append_blocks(nullptr,data,size,file,options);
+}
+
+//Decompresses a file of blocks.  The file is read from input_file, or, if it is nullptr, taken from the buffer.
+static bool read_blocks(std::istream* input_file,const unsigned char* data,size_t size,std::ostream& output_file,
+        unsigned threads,job_stats* stats){
+    const unsigned char* end_of_data = data + size;
+    unsigned char file_header[FILE_HEADER_SIZE - 4];
+    if(input_file){
+        input_file->read(reinterpret_cast<char*>(file_header),sizeof(file_header));
+        if(!*input_file)
+            return false;
+    }else{
+        if(size < sizeof(file_header))
+            return false;
+        memcpy(file_header,data,sizeof(file_header));
+        data += sizeof(file_header);
+    }
+    if(file_header[0] != BLOCK_FORMAT_VERSION || (file_header[1] & ~KNOWN_FLAGS) != 0)
+        return false;
+    unsigned char flags = file_header[1];
+    uint32_t block_size = get_u32(file_header + 2);
+    if(stats)
+        stats->set_header_size(FILE_HEADER_SIZE);
+
+    thread_pool pool(threads);
+    size_t batch_size = pool.size() * 2;
+    //The payload of each block in the batch.  Payloads that are read from a stream are stored in payloads; the
+    //payloads in a buffer are decoded where they are.
+    std::vector<std::vector<unsigned char> > payloads(input_file ? batch_size : 0);
+    std::vector<const unsigned char*> payload_data(batch_size);
+    std::vector<size_t> payload_sizes(batch_size);
+    std::vector<unsigned char> payload_types(batch_size);
+    std::vector<std::vector<unsigned char> > outputs(batch_size);
+    //vector<bool> is not used since its elements cannot be written by different threads at the same time.
+    std::vector<char> decoded(batch_size);
+    bool end = false;
+    while(!end){
+        //Read blocks until the batch is full or the end block is reached.
+        size_t blocks = 0;
+        while(!end && blocks < batch_size){
+            block_header header;
+            if(input_file){
+                if(!read_block_header(*input_file,header) || header.raw_size > block_size)
+                    return false;
+                //The payload of a block that holds no data is skipped without being stored.  The payload of the
+                //others is only allocated if its size is possible for the amount of data.
+                if(!holds_data(header.type)){
+                    input_file->ignore(header.payload_size);
+                    if(static_cast<uint64_t>(input_file->gcount()) != header.payload_size)
+                        return false;
+                }else{
+                    if(header.payload_size > max_payload_size(flags,header.raw_size))
+                        return false;
+                    auto& payload = payloads[blocks];
+                    payload.resize(header.payload_size);
+                    input_file->read(reinterpret_cast<char*>(payload.data()),payload.size());
+                    if(!*input_file)
+                        return false;
+                    payload_data[blocks] = payload.data();
+                }
+            }else{
+                data = read_block_header(data,end_of_data,header);
+                if(!data || header.raw_size > block_size ||
+                        header.payload_size > static_cast<size_t>(end_of_data - data) ||
+                        (holds_data(header.type) && header.payload_size > max_payload_size(flags,header.raw_size)))
+                    return false;
+                payload_data[blocks] = data;
+                data += header.payload_size;
+            }
+            payload_sizes[blocks] = header.payload_size;
+            payload_types[blocks] = header.type;
+            //An end block that is followed by more blocks was the end of the file before something was appended to it.
+            if(header.type == END_BLOCK){
+                end = input_file ? input_file->peek() == std::char_traits<char>::eof() : data == end_of_data;
+            }else if(holds_data(header.type)){
+                outputs[blocks].resize(header.raw_size);
+                ++blocks;
+            //The directory and index are only needed to find data without reading what comes before it.
+            }else if(header.type != DIRECTORY_BLOCK && header.type != INDEX_BLOCK){
+                return false;
+            }
+        }
+        if(stats)
+            stats->start(CODE_PHASE);
+        uint64_t batch_bytes = 0;
+        for(size_t block = 0;block < blocks;++block){
+            batch_bytes += outputs[block].size();
+            pool.submit([&payload_data,&payload_sizes,&payload_types,&outputs,&decoded,flags,block]{
+                decoded[block] = decode_block(flags,payload_types[block],payload_data[block],payload_sizes[block],
+                    outputs[block].data(),outputs[block].size());
+            });
+        }
+        pool.wait();
+        if(stats){
+            stats->stop(CODE_PHASE,batch_bytes);
+            stats->start(WRITE_PHASE);
+        }
+        for(size_t block = 0;block < blocks;++block){
+            if(!decoded[block])
+                return false;
+            output_file.write(reinterpret_cast<const char*>(outputs[block].data()),outputs[block].size());
+        }
+        output_file.flush();
+        if(stats)
+            stats->stop(WRITE_PHASE,batch_bytes);
+    }
+    return true;
+}
+
+bool decompress_blocks(std::istream& input_file,std::ostream& output_file,unsigned threads,job_stats* stats){
+    return read_blocks(&input_file,nullptr,0,output_file,threads,stats);
+}
+
+bool decompress_blocks(const unsigned char* data,size_t size,std::ostream& output_file,unsigned threads,
+        job_stats* stats){
+    return read_blocks(nullptr,data,size,output_file,threads,stats);
+}
@@ -0,0 +1,90 @@
+/*
+This file contains the functions that compress and decompress files in blocks (see block_format.h).  The input is
+split into blocks of a fixed size, and each block is compressed with its own encoding, which is based on the
+frequencies of the characters in that block alone.  The blocks are compressed by a thread_pool, a batch of them at a
+time, and written to the output in order, so the output does not depend on the number of threads.  Decompression
+reads a batch of blocks at a time and decodes them on the thread_pool in the same way.  Each batch is written, and
+the output is flushed, as soon as it is done, so only one batch is held in memory at a time.  That allows both
+functions to work on streams that cannot be read twice or seeked, such as pipes.
+*/
+#ifndef BLOCK_CODEC_H_
+#define BLOCK_CODEC_H_
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include "create_encoding.h"
+#include "decode_table.h"
+#include "encode_table.h"
+#include "job_stats.h"
+
+struct block_options{
+    //The number of bytes of the input in each block.
+    uint32_t block_size;
+    //The number of threads that compress or decompress blocks.
+    unsigned threads;
+    //Whether to write the directory at the end of the file.  Without it, the memory used does not depend on the size
+    //of the input.
+    bool directory;
+    //The number of characters between checkpoints in the index, or 0 to leave out the index.  The index is only
+    //written along with the directory.
+    uint32_t index_interval;
+    //The longest bitstring in the encoding of a block.
+    unsigned max_code_length;
+    //The number of bitstreams that the characters of each block are dealt to, at most MAX_STREAMS.  Blocks with more
+    //than one bitstream have no checkpoints.
+    unsigned streams;
+    //The checksums that each block holds, as the flags in the file header (see block_format.h).
+    unsigned char checksums;
+};
+
+//Deals the characters of the data to streams bitstreams in turn, between 2 and MAX_STREAMS of them, encodes each one
+//with the table, and appends them to the destination as they are laid out in a multi-stream block after its table of
+//lengths: the number of bitstreams, the size of each one but the last, and the bitstreams.
+void encode_streams(const encode_table& table,const unsigned char* data,size_t size,unsigned streams,
+    std::vector<unsigned char>& destination);
+//Decodes the raw_size characters of bitstreams written by encode_streams, which run from bits to end, into output.
+//Returns false if they are corrupt.
+bool decode_streams(const decode_table& table,const unsigned char* bits,const unsigned char* end,unsigned char* output,
+    size_t raw_size);
+//Compresses a block of data, appending the block (including its header) to the buffer, with the length limit, the
+//number of bitstreams and the checksums in the options.  The block is stored instead if encoding it would not save
+//MIN_ENCODING_GAIN of its size (see histogram.h).  If checkpoints is not nullptr and the block has a single bitstream,
+//the position in the payload (in bits) of every index_interval-th character after the first is appended to it.  If
+//cost is not nullptr, the size of the block's bitstreams with and without the limit on the length is added to it.
+void encode_block(const unsigned char* data,size_t size,std::vector<unsigned char>& destination,
+    const block_options& options,std::vector<uint64_t>* checkpoints = nullptr,limit_cost* cost = nullptr);
+//Decompresses the payload of a block of the given type into output, which has room for the raw_size bytes it
+//decompresses to.  flags are the flags of the file header, which say which checksums to verify.  Returns false if
+//the block is corrupt.
+bool decode_block(unsigned char flags,unsigned char type,const unsigned char* payload,size_t payload_size,
+    unsigned char* output,size_t raw_size);
+
+//Reads the input until the end and writes it to the output in blocks.  The magic number should already have been
+//written to the output.  Returns the size of the bitstreams of all of the blocks with and without the limit on the
+//length of the bitstrings.  Unless stats is nullptr, the time spent compressing each batch of blocks and writing it
+//is recorded in it (see job_stats.h).
+limit_cost compress_blocks(std::istream& input_file,std::ostream& output_file,const block_options& options,
+    job_stats* stats = nullptr);
+//Compresses the buffer, such as a file that was mapped into memory, without copying the blocks.
+limit_cost compress_blocks(const unsigned char* data,size_t size,std::ostream& output_file,const block_options& options,
+    job_stats* stats = nullptr);
+//Appends the input to a file of blocks, which has to be open for both reading and writing, without reading or
+//rewriting the blocks that are already in it.  The new blocks, with the file's block size and checksums and the rest of
+//the options, are written after the end block, followed by a directory of only the new blocks that holds the position
+//of the previous directory, and a new end block.  Nothing that was in the file is overwritten, so if the append is
+//interrupted, cutting the file back to its old size restores it.  Every block starts at a whole byte and holds its own
+//table, so decompressing the file yields the old data followed by the new.  Returns false if the file is not a valid
+//file of blocks or cannot be written.
+bool append_blocks(std::istream& input_file,std::iostream& file,const block_options& options);
+//Appends the buffer, such as a file that was mapped into memory, without copying the blocks.
+bool append_blocks(const unsigned char* data,size_t size,std::iostream& file,const block_options& options);
+//Decompresses a file of blocks whose magic number was already read, recording the time spent in stats as
+//compress_blocks does.  Returns false if the file is corrupt.
+bool decompress_blocks(std::istream& input_file,std::ostream& output_file,unsigned threads,
+    job_stats* stats = nullptr);
+//Decompresses a file of blocks in a buffer, starting after the magic number, decoding the payloads where they are.
+bool decompress_blocks(const unsigned char* data,size_t size,std::ostream& output_file,unsigned threads,
+    job_stats* stats = nullptr);
+
+#endif // BLOCK_CODEC_H_
@@ -0,0 +1,127 @@
+#include "block_format.h"
+
+void put_u32(std::vector<unsigned char>& destination,uint32_t number){
+    for(unsigned byte = 0;byte < 4;++byte){
+        destination.push_back(number >> (byte * 8));
+    }
+}
+
+void put_u64(std::vector<unsigned char>& destination,uint64_t number){
+    for(unsigned byte = 0;byte < 8;++byte){
+        destination.push_back(number >> (byte * 8));
+    }
+}
+
+void set_u32(unsigned char* destination,uint32_t number){
+    for(unsigned byte = 0;byte < 4;++byte){
+        destination[byte] = number >> (byte * 8);
+    }
+}
+
+uint32_t get_u32(const unsigned char* source){
+    uint32_t number = 0;
+    for(unsigned byte = 0;byte < 4;++byte){
+        number |= static_cast<uint32_t>(source[byte]) << (byte * 8);
+    }
+    return number;
+}
+
+uint64_t get_u64(const unsigned char* source){
+    uint64_t number = 0;
+    for(unsigned byte = 0;byte < 8;++byte){
+        number |= static_cast<uint64_t>(source[byte]) << (byte * 8);
+    }
+    return number;
+}
+
+void write_block_header(std::vector<unsigned char>& destination,const block_header& header){
+    destination.push_back(header.type);
+    put_u32(destination,header.raw_size);
+    put_u32(destination,header.payload_size);
+}
+
+bool read_block_header(std::istream& source,block_header& header){
+    unsigned char buffer[BLOCK_HEADER_SIZE];
+    source.read(reinterpret_cast<char*>(buffer),BLOCK_HEADER_SIZE);
+    return source && read_block_header(buffer,buffer + BLOCK_HEADER_SIZE,header);
+}
+
+const unsigned char* read_block_header(const unsigned char* source,const unsigned char* end,block_header& header){
+    if(static_cast<size_t>(end - source) < BLOCK_HEADER_SIZE)
+        return nullptr;
+    header.type = source[0];
+    header.raw_size = get_u32(source + 1);
+    header.payload_size = get_u32(source + 5);
+    return source + BLOCK_HEADER_SIZE;
+}
+
+void write_directory(std::vector<unsigned char>& destination,const std::vector<directory_entry>& entries,
+        uint64_t previous){
+    block_header header = {DIRECTORY_BLOCK,0,static_cast<uint32_t>(8 + 8 + entries.size() * 16)};
+    write_block_header(destination,header);
+    put_u64(destination,previous);
+    put_u64(destination,entries.size());
+    for(auto& entry:entries){
+        put_u64(destination,entry.raw_offset);
+        put_u64(destination,entry.file_offset);
+    }
+}
+
+bool read_directory(const std::vector<unsigned char>& payload,std::vector<directory_entry>& entries,
+        uint64_t& previous){
+    if(payload.size() < 16)
+        return false;
+    previous = get_u64(payload.data());
+    uint64_t count = get_u64(payload.data() + 8);
+    if(count != (payload.size() - 16) / 16 || payload.size() % 16 != 0)
+        return false;
+    entries.resize(count);
+    for(uint64_t entry = 0;entry < count;++entry){
+        entries[entry].raw_offset = get_u64(payload.data() + 16 + entry * 16);
+        entries[entry].file_offset = get_u64(payload.data() + 24 + entry * 16);
+    }
+    return true;
+}
+
+void write_index(std::vector<unsigned char>& destination,uint32_t interval,
+        const std::vector<std::vector<uint64_t> >& checkpoints){
+    std::vector<unsigned char> payload;
+    put_u32(payload,interval);
+    for(auto& block:checkpoints){
+        put_u32(payload,block.size());
+        for(auto bit_offset:block){
+            put_u64(payload,bit_offset);
+        }
+    }
+    block_header header = {INDEX_BLOCK,0,static_cast<uint32_t>(payload.size())};
+    write_block_header(destination,header);
+    destination.insert(destination.end(),payload.begin(),payload.end());
+}
+
+bool read_index(const std::vector<unsigned char>& payload,uint32_t& interval,
+        std::vector<std::vector<uint64_t> >& checkpoints){
+    if(payload.size() < 4)
+        return false;
+    interval = get_u32(payload.data());
+    checkpoints.clear();
+    size_t position = 4;
+    while(position < payload.size()){
+        if(payload.size() - position < 4)
+            return false;
+        uint32_t count = get_u32(payload.data() + position);
+        position += 4;
+        if((payload.size() - position) / 8 < count)
+            return false;
+        checkpoints.push_back(std::vector<uint64_t>(count));
+        for(uint32_t checkpoint = 0;checkpoint < count;++checkpoint,position += 8){
+            checkpoints.back()[checkpoint] = get_u64(payload.data() + position);
+        }
+    }
+    return interval != 0;
+}
+
+void write_end_block(std::vector<unsigned char>& destination,uint64_t directory_offset){
+    block_header header = {END_BLOCK,0,8};
+    write_block_header(destination,header);
+    put_u64(destination,directory_offset);
+}
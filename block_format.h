@@ -0,0 +1,134 @@
+/*
+This file defines the layout of files that are compressed in blocks.  The file starts with the magic number, the
+version of the format, a byte of flags, and the size of the blocks.  It is followed by a sequence of blocks, each of
+which starts with a header holding the type of the block, the number of bytes it decompresses to, and the number of
+bytes that follow the header.  Since every block holds its own encoding table and starts at a whole byte, each one
+can be compressed and decompressed independently of the others.  A block whose data encoding would not make smaller,
+such as data that is already compressed or encrypted, is stored as it is instead.
+
+After the blocks that hold data there is a directory block, which lists the position of each block in the original
+file and in the compressed file, and the file ends with an end block, whose payload is the position of the
+directory.  A file whose end block holds 0 has no directory.  The directory may be followed by an index block, which
+lists checkpoints inside each block: positions in the bitstream at which a character starts, at a fixed interval of
+characters, so that part of a block can be decoded without decoding the part before it.  Appending to a file (see
+append_blocks) adds the new blocks after its end block, followed by a directory and index of them whose directory
+holds the position of the previous directory, and a new end block.  The directories of a file that was appended to
+form a chain, and only the end block at the end of the file ends it.
+
+The flags in the file header say which checksums the blocks hold.  With DATA_CRC_FLAG, the payload of every block
+that holds data ends with the CRC32C (see crc32c.h) of the data it decompresses to, and with PAYLOAD_CRC_FLAG, that is
+followed by the CRC32C of the rest of the payload, which can be checked before the block is decoded.
+
+All numbers are stored with the least significant byte first.
+*/
+#ifndef BLOCK_FORMAT_H_
+#define BLOCK_FORMAT_H_
+#include <cstdint>
+#include <istream>
+#include <vector>
+
+const char BLOCK_MAGIC_NUMBER[] = "hufb";
+const unsigned char BLOCK_FORMAT_VERSION = 1;
+//The size of the magic number, the version, the flags and the block size.
+const size_t FILE_HEADER_SIZE = 4 + 1 + 1 + 4;
+//The size of the type, the size of the data and the size of the payload.
+const size_t BLOCK_HEADER_SIZE = 1 + 4 + 4;
+//The size of the end block, which includes the position of the directory.
+const size_t END_BLOCK_SIZE = BLOCK_HEADER_SIZE + 8;
+const uint32_t DEFAULT_BLOCK_SIZE = 1 << 20;
+//The flags in the file header.
+const unsigned char DATA_CRC_FLAG = 1;
+const unsigned char PAYLOAD_CRC_FLAG = 2;
+const unsigned char KNOWN_FLAGS = DATA_CRC_FLAG | PAYLOAD_CRC_FLAG;
+//Returns the number of bytes of checksums at the end of the payload of each block that holds data.
+inline size_t checksums_size(unsigned char flags){
+    return (flags & DATA_CRC_FLAG ? 4 : 0) + (flags & PAYLOAD_CRC_FLAG ? 4 : 0);
+}
+//The largest number of bitstreams in a block.
+const unsigned MAX_STREAMS = 16;
+//The largest possible table of lengths: the longest length, the number of characters, the map of characters, and a
+//byte for each length.
+const size_t MAX_LENGTHS_SIZE = 2 + 256 / 8 + 256;
+//Returns the largest payload that a block holding raw_size bytes of data can have.  Bitstrings limited to 8 bits or
+//more never take more bits than the characters they encode, so a payload is at most its table, the number and sizes
+//of its bitstreams, a byte of padding at the end of each bitstream, the data, and the checksums.  Headers that claim
+//more than that are corrupt, and are rejected before the payload is allocated.
+inline uint64_t max_payload_size(unsigned char flags,uint32_t raw_size){
+    return static_cast<uint64_t>(raw_size) + MAX_LENGTHS_SIZE + 1 + 4 * (MAX_STREAMS - 1) + MAX_STREAMS +
+        checksums_size(flags);
+}
+
+enum block_type{
+    //Marks the end of the file.  Its payload is the position of the directory in the file.
+    END_BLOCK = 0,
+    //Holds a table of lengths (see write_lengths) followed by the bitstream.
+    HUFFMAN_BLOCK = 1,
+    //Holds a table of lengths, the number of bitstreams, the size in bytes of each bitstream but the last, and the
+    //bitstreams.  The characters of the block are dealt to the bitstreams in turn, so the decoder can decode one
+    //character from each of them at the same time.
+    MULTI_STREAM_BLOCK = 2,
+    //Holds the data of the block as it is, for data that encoding would not make smaller.
+    STORED_BLOCK = 3,
+    //Holds the position of the previous directory, the number of entries, and the entries.
+    DIRECTORY_BLOCK = 0x10,
+    //Holds the interval between checkpoints, then, for each block in the directory, the number of checkpoints in it
+    //and the position of each one in the block's payload, in bits.  The checkpoint at the start of the bitstream
+    //is not listed.
+    INDEX_BLOCK = 0x11,
+    //Holds the members of an archive (see archive.h): their number, then the length of each one's path, the path,
+    //its size, the number of its blocks, and the position of each block, all written with write_number.
+    FILE_INDEX_BLOCK = 0x12
+};
+
+//Returns whether blocks of the type hold data of the file, as opposed to the directory, the index or the end.
+inline bool holds_data(unsigned char type){
+    return type == HUFFMAN_BLOCK || type == MULTI_STREAM_BLOCK || type == STORED_BLOCK;
+}
+
+struct block_header{
+    unsigned char type;
+    //The number of bytes the block decompresses to.
+    uint32_t raw_size;
+    //The number of bytes after the header.
+    uint32_t payload_size;
+};
+
+struct directory_entry{
+    //The position of the block's data in the original file.
+    uint64_t raw_offset;
+    //The position of the block's header in the compressed file.
+    uint64_t file_offset;
+};
+
+//Appends numbers to the buffer, least significant byte first.
+void put_u32(std::vector<unsigned char>& destination,uint32_t number);
+void put_u64(std::vector<unsigned char>& destination,uint64_t number);
+//Overwrites 4 bytes of a buffer with the number, least significant byte first.
+void set_u32(unsigned char* destination,uint32_t number);
+//Reads numbers from the buffer, least significant byte first.
+uint32_t get_u32(const unsigned char* source);
+uint64_t get_u64(const unsigned char* source);
+
+//Appends the header of a block to the buffer.
+void write_block_header(std::vector<unsigned char>& destination,const block_header& header);
+//Reads the header of a block from the file.  Returns false if the file ends first.
+bool read_block_header(std::istream& source,block_header& header);
+//Reads the header of a block from the buffer.  Returns a pointer past the header, or nullptr if the buffer ends first.
+const unsigned char* read_block_header(const unsigned char* source,const unsigned char* end,block_header& header);
+//Appends a directory block with the entries to the buffer.  previous is the position of the directory of the
+//previous part of the file, or 0.
+void write_directory(std::vector<unsigned char>& destination,const std::vector<directory_entry>& entries,
+    uint64_t previous);
+//Reads the entries from the payload of a directory block.  Returns false if the payload is invalid.
+bool read_directory(const std::vector<unsigned char>& payload,std::vector<directory_entry>& entries,
+    uint64_t& previous);
+//Appends an index block with the checkpoints of each block to the buffer.
+void write_index(std::vector<unsigned char>& destination,uint32_t interval,
+    const std::vector<std::vector<uint64_t> >& checkpoints);
+//Reads the checkpoints from the payload of an index block.  Returns false if the payload is invalid.
+bool read_index(const std::vector<unsigned char>& payload,uint32_t& interval,
+    std::vector<std::vector<uint64_t> >& checkpoints);
+//Appends an end block to the buffer.
+void write_end_block(std::vector<unsigned char>& destination,uint64_t directory_offset);
+
+#endif // BLOCK_FORMAT_H_
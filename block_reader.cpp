@@ -0,0 +1,210 @@
+#include "block_reader.h"
+#include <algorithm>
+#include <cstring>
+#include "block_codec.h"
+#include "decode_table.h"
+#include "encoding_table.h"
+#include "ibitstream.h"
+
+block_reader::block_reader(std::istream& source)
+    :source(source),
+    raw_size(0),
+    file_size(0),
+    flags(0)
+    {}
+
+bool block_reader::open(){
+    unsigned char file_header[FILE_HEADER_SIZE];
+    source.seekg(0,std::ios::beg);
+    source.read(reinterpret_cast<char*>(file_header),FILE_HEADER_SIZE);
+    if(!source || memcmp(file_header,BLOCK_MAGIC_NUMBER,4) != 0 || file_header[4] != BLOCK_FORMAT_VERSION ||
+            (file_header[5] & ~KNOWN_FLAGS) != 0)
+        return false;
+    flags = file_header[5];
+
+    //The end block is at the end of the file, and holds the position of the directory.
+    source.seekg(0,std::ios::end);
+    file_size = source.tellg();
+    if(file_size < FILE_HEADER_SIZE + END_BLOCK_SIZE)
+        return false;
+    block_header header;
+    std::vector<unsigned char> payload;
+    if(!read_block(file_size - END_BLOCK_SIZE,header,payload) || header.type != END_BLOCK || payload.size() != 8)
+        return false;
+    uint64_t directory_offset = get_u64(payload.data());
+    if(directory_offset == 0)
+        return scan_blocks(file_size - END_BLOCK_SIZE);
+
+    //Each append to the file wrote a directory of its own blocks, followed by their index if they have one, and
+    //holding the position of the directory before it.  The directories are read from the last one back, and their
+    //blocks put in order afterwards.
+    std::vector<std::vector<directory_entry> > parts;
+    std::vector<uint32_t> part_intervals;
+    std::vector<std::vector<std::vector<uint64_t> > > part_checkpoints;
+    while(directory_offset != 0){
+        parts.emplace_back();
+        part_intervals.push_back(0);
+        part_checkpoints.emplace_back();
+        uint64_t previous;
+        if(!read_block(directory_offset,header,payload) || header.type != DIRECTORY_BLOCK ||
+                !read_directory(payload,parts.back(),previous) || previous >= directory_offset)
+            return false;
+        //The index, if there is one, comes right after the directory.  Otherwise a data block of a later append may
+        //follow it, so only the header is read until the type is known.
+        uint64_t index_offset = directory_offset + BLOCK_HEADER_SIZE + payload.size();
+        if(!read_header(index_offset,header))
+            return false;
+        if(header.type == INDEX_BLOCK && (!read_block(index_offset,header,payload) ||
+                !read_index(payload,part_intervals.back(),part_checkpoints.back()) ||
+                part_checkpoints.back().size() != parts.back().size()))
+            return false;
+        part_checkpoints.back().resize(parts.back().size());
+        directory_offset = previous;
+    }
+    for(size_t part = parts.size();part-- > 0;){
+        blocks.insert(blocks.end(),parts[part].begin(),parts[part].end());
+        intervals.insert(intervals.end(),parts[part].size(),part_intervals[part]);
+        checkpoints.insert(checkpoints.end(),part_checkpoints[part].begin(),part_checkpoints[part].end());
+    }
+    //The size of the last block is in its header.
+    if(!blocks.empty()){
+        if(!read_header(blocks.back().file_offset,header))
+            return false;
+        raw_size = blocks.back().raw_offset + header.raw_size;
+    }
+    return true;
+}
+
+bool block_reader::scan_blocks(uint64_t end_offset){
+    uint64_t position = FILE_HEADER_SIZE;
+    while(position < end_offset){
+        block_header header;
+        if(!read_header(position,header))
+            return false;
+        if(holds_data(header.type)){
+            directory_entry entry = {raw_size,position};
+            blocks.push_back(entry);
+            intervals.push_back(0);
+            checkpoints.emplace_back();
+            raw_size += header.raw_size;
+        }
+        position += BLOCK_HEADER_SIZE + header.payload_size;
+    }
+    return position == end_offset;
+}
+
+bool block_reader::read_header(uint64_t position,block_header& header){
+    source.clear();
+    source.seekg(position,std::ios::beg);
+    return read_block_header(source,header);
+}
+
+bool block_reader::read_block(uint64_t position,block_header& header,std::vector<unsigned char>& payload){
+    //The payload has to fit in the file before it is allocated.
+    if(!read_header(position,header) || header.payload_size > file_size - position - BLOCK_HEADER_SIZE)
+        return false;
+    payload.resize(header.payload_size);
+    source.read(reinterpret_cast<char*>(payload.data()),payload.size());
+    return static_cast<bool>(source);
+}
+
+uint64_t block_reader::size() const{
+    return raw_size;
+}
+
+bool block_reader::extract(uint64_t offset,uint64_t length,std::ostream& output){
+    if(offset > raw_size || length > raw_size - offset)
+        return false;
+    //Find the last block that starts at or before the offset.
+    directory_entry key = {offset,0};
+    size_t block = std::upper_bound(blocks.begin(),blocks.end(),key,
+        [](const directory_entry& a,const directory_entry& b){return a.raw_offset < b.raw_offset;}) - blocks.begin();
+    std::vector<unsigned char> buffer;
+    //Continue with the following blocks until the whole range was decompressed.
+    for(--block;length > 0;++block){
+        uint64_t block_end = block + 1 < blocks.size() ? blocks[block + 1].raw_offset : raw_size;
+        uint64_t count = std::min(length,block_end - offset);
+        if(!extract_block(block,offset - blocks[block].raw_offset,count,buffer))
+            return false;
+        output.write(reinterpret_cast<const char*>(buffer.data()),buffer.size());
+        offset += count;
+        length -= count;
+    }
+    return true;
+}
+
+bool block_reader::extract_block(size_t block,uint64_t offset,uint64_t length,std::vector<unsigned char>& output){
+    block_header header;
+    source.clear();
+    source.seekg(blocks[block].file_offset,std::ios::beg);
+    if(!read_block_header(source,header) || offset + length > header.raw_size ||
+            header.payload_size > max_payload_size(flags,header.raw_size))
+        return false;
+    //A block with several bitstreams has no checkpoints, so it is decoded in full.  So is a block that is needed in
+    //full anyway, which lets its checksums be verified.
+    if(header.type == MULTI_STREAM_BLOCK || (flags != 0 && offset == 0 && length == header.raw_size)){
+        std::vector<unsigned char> payload(header.payload_size);
+        std::vector<unsigned char> decoded(header.raw_size);
+        source.read(reinterpret_cast<char*>(payload.data()),payload.size());
+        if(!source || !decode_block(flags,header.type,payload.data(),payload.size(),decoded.data(),
+                decoded.size()))
+            return false;
+        output.assign(decoded.begin() + offset,decoded.begin() + offset + length);
+        return true;
+    }
+    uint64_t payload_offset = blocks[block].file_offset + BLOCK_HEADER_SIZE;
+    //A stored block holds the data itself, so the range is read straight from its position in the payload.
+    if(header.type == STORED_BLOCK){
+        if(header.payload_size != header.raw_size + checksums_size(flags))
+            return false;
+        output.resize(length);
+        source.seekg(payload_offset + offset,std::ios::beg);
+        source.read(reinterpret_cast<char*>(output.data()),length);
+        return static_cast<bool>(source);
+    }
+    if(header.type != HUFFMAN_BLOCK)
+        return false;
+
+    //Read the table of lengths at the start of the payload.
+    std::vector<unsigned char> table_bytes(std::min<size_t>(header.payload_size,MAX_LENGTHS_SIZE));
+    source.read(reinterpret_cast<char*>(table_bytes.data()),table_bytes.size());
+    code_lengths lengths;
+    const unsigned char* table_end = read_lengths(table_bytes.data(),table_bytes.data() + table_bytes.size(),lengths);
+    if(!source || !table_end)
+        return false;
+
+    //Start at the last checkpoint before the offset, and read up to the first checkpoint after the range.
+    uint64_t start_character = 0;
+    uint64_t start_bit = (table_end - table_bytes.data()) * 8;
+    uint64_t end_byte = header.payload_size;
+    uint32_t interval = intervals[block];
+    if(interval != 0){
+        auto& block_checkpoints = checkpoints[block];
+        uint64_t before = std::min<uint64_t>(offset / interval,block_checkpoints.size());
+        if(before > 0){
+            start_character = before * interval;
+            start_bit = block_checkpoints[before - 1];
+        }
+        uint64_t after = (offset + length + interval - 1) / interval;
+        if(after > 0 && after <= block_checkpoints.size())
+            end_byte = std::min<uint64_t>(end_byte,(block_checkpoints[after - 1] + 7) / 8);
+    }
+    if(start_bit / 8 > end_byte)
+        return false;
+    std::vector<unsigned char> bits(end_byte - start_bit / 8);
+    source.seekg(payload_offset + start_bit / 8,std::ios::beg);
+    source.read(reinterpret_cast<char*>(bits.data()),bits.size());
+    if(!source)
+        return false;
+
+    decode_table table(lengths);
+    ibitstream bits_stream(bits.data(),bits.size());
+    bits_stream.skip(start_bit % 8);
+    //Decode and discard the characters between the checkpoint and the offset.
+    for(uint64_t position = start_character;position < offset;++position){
+        if(bits_stream.decode(table) < 0)
+            return false;
+    }
+    output.resize(length);
+    return bits_stream.decode(table,output.data(),length) == length;
+}
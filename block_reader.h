@@ -0,0 +1,54 @@
+/*
+This file contains the block_reader class, which decompresses a range of a file that was compressed in blocks
+without decoding the rest of the file.  It uses the directory to find the block that holds the start of the range,
+and, if the file has an index, the last checkpoint in that block before the range, so the amount of data that is read
+and decoded depends on the size of the range and the interval between checkpoints, not on where the range is.  Files
+without a directory (such as those written to a stream) are handled by reading the header of each block to find the
+blocks, which seeks over their payloads.
+*/
+#ifndef BLOCK_READER_H_
+#define BLOCK_READER_H_
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include "block_format.h"
+
+class block_reader{
+public:
+    //Takes a file of blocks, which has to be seekable.
+    explicit block_reader(std::istream& source);
+    //Reads the directory and the index.  Returns false if the file is not a valid file of blocks.
+    bool open();
+    //The number of bytes the file decompresses to.
+    uint64_t size() const;
+    //Decompresses length bytes starting at offset in the original file and writes them to the output.  Returns false
+    //if the range is past the end of the file or the file is corrupt.
+    bool extract(uint64_t offset,uint64_t length,std::ostream& output);
+
+private:
+    //Decompresses length bytes starting at offset in the block into output.
+    bool extract_block(size_t block,uint64_t offset,uint64_t length,std::vector<unsigned char>& output);
+    //Finds the blocks by reading their headers, for files without a directory, up to the end block at end_offset.
+    bool scan_blocks(uint64_t end_offset);
+    //Reads the header of the block that starts at the position.
+    bool read_header(uint64_t position,block_header& header);
+    //Reads the header and payload of the block that starts at the position.
+    bool read_block(uint64_t position,block_header& header,std::vector<unsigned char>& payload);
+
+    std::istream& source;
+    std::vector<directory_entry> blocks;
+    //The size of the original file.
+    uint64_t raw_size;
+    //The size of the compressed file.
+    uint64_t file_size;
+    //The flags in the file header, which say which checksums the blocks hold.  Only blocks that are decoded in full
+    //are verified, since the checksums cover the whole block.
+    unsigned char flags;
+    //The number of characters between checkpoints in each block, and its checkpoints.  Each part of a file that was
+    //appended to (see append_blocks) has its own index, if any, so blocks of parts without one have an interval of 0.
+    std::vector<uint32_t> intervals;
+    std::vector<std::vector<uint64_t> > checkpoints;
+};
+
+#endif // BLOCK_READER_H_
@@ -0,0 +1,30 @@
+#!/bin/sh
+#Decompresses files whose correct output is known and compares the output, with the sequential decoder and with the
+#parallel one.  Run by make check.
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+failures=0
+
+#Decompresses the file with each number of threads and compares the output with the expected file.
+check_decompress(){
+    name=$1
+    for threads in 1 4; do
+        output="$work/$name.$threads.out"
+        if ! ./huffman -d -j $threads "$work/$name.huf" "$output" || ! cmp -s "$output" "$work/$name"; then
+            echo "FAIL: $name with $threads threads"
+            failures=$((failures + 1))
+        fi
+    done
+}
+
+#A legacy file of "aaaaa\377", whose EOF character is 0xFF and is the last character of the bitstream, with no
+#padding after it.
+printf 'aaaaa\377' > "$work/legacy_eof_ff"
+printf 'huff\001a\300\377@a\377\037' > "$work/legacy_eof_ff.huf"
+check_decompress legacy_eof_ff
+
+if [ $failures -ne 0 ]; then
+    echo "$failures checks failed."
+    exit 1
+fi
+echo "All checks passed."
@@ -0,0 +1,160 @@
+#include "code_builder.h"
+#include <algorithm>
+
+unsigned code_builder::sort_characters(const frequency_table& table){
+    //Each character is sorted as a single number holding its frequency above the character, which puts characters
+    //with the same frequency in the order of the characters, so the lengths are deterministic.  That requires the
+    //frequencies to fit in 56 bits, which they do unless the input is larger than 64 petabytes.
+    unsigned count = 0;
+    for(unsigned character = 0;character < table.size();++character){
+        if(table[character] != 0)
+            depths[count++] = static_cast<uint64_t>(table[character]) << 8 | character;
+    }
+    std::sort(depths.begin(),depths.begin() + count);
+    for(unsigned position = 0;position < count;++position){
+        characters[position] = depths[position] & 0xff;
+        frequencies[position] = depths[position] >> 8;
+    }
+    return count;
+}
+
+unsigned code_builder::optimal_lengths(const frequency_table& table){
+    unsigned count = sort_characters(table);
+    std::copy(frequencies.begin(),frequencies.begin() + count,depths.begin());
+    //A single character still needs a bitstring of one bit.
+    if(count == 1)
+        depths[0] = 1;
+    else if(count > 1)
+        minimum_redundancy(count);
+    return count;
+}
+
+void code_builder::build(const frequency_table& table,code_lengths& lengths){
+    unsigned count = optimal_lengths(table);
+    lengths.fill(0);
+    for(unsigned position = 0;position < count;++position){
+        lengths[characters[position]] = depths[position];
+    }
+}
+
+void code_builder::build(const frequency_table& table,unsigned max_length,code_lengths& lengths,limit_cost* cost){
+    unsigned count = optimal_lengths(table);
+    uint64_t optimal_bits = 0;
+    for(unsigned position = 0;position < count;++position){
+        optimal_bits += frequencies[position] * depths[position];
+    }
+    //The least frequent character has the longest bitstring.
+    if(count > 0 && depths[0] > max_length)
+        package_merge(count,max_length);
+    lengths.fill(0);
+    uint64_t limited_bits = 0;
+    for(unsigned position = 0;position < count;++position){
+        lengths[characters[position]] = depths[position];
+        limited_bits += frequencies[position] * depths[position];
+    }
+    if(cost){
+        cost->optimal_bits += optimal_bits;
+        cost->limited_bits += limited_bits;
+    }
+}
+
+//The first pass combines the two least frequent nodes count - 1 times.  Leaves are taken from the front of the
+//sorted frequencies, and each internal node is stored over the leaf at the next position, so the array holds the
+//unused leaves after next, the internal nodes between root and next that have no parent yet, and, before root, the
+//internal nodes that have one, which store the position of their parent instead of their frequency.  The second pass
+//turns the parent positions into depths, and the third assigns the depths of the leaves from the number of internal
+//nodes at each depth.
+void code_builder::minimum_redundancy(unsigned count){
+    auto& a = depths;
+    unsigned root = 0,leaf = 2,next;
+    a[0] += a[1];
+    for(next = 1;next < count - 1;++next){
+        //Take the first child from whichever queue has the smaller frequency.
+        if(leaf >= count || a[root] < a[leaf]){
+            a[next] = a[root];
+            a[root++] = next;
+        }else{
+            a[next] = a[leaf++];
+        }
+        //Then the second one.
+        if(leaf >= count || (root < next && a[root] < a[leaf])){
+            a[next] += a[root];
+            a[root++] = next;
+        }else{
+            a[next] += a[leaf++];
+        }
+    }
+
+    //The root of the tree is the last internal node.
+    a[count - 2] = 0;
+    for(unsigned node = count - 2;node-- > 0;){
+        a[node] = a[a[node]] + 1;
+    }
+
+    //Each depth has twice as many nodes as there are internal nodes at the depth above it.  The ones that are not
+    //internal nodes are leaves, and the least frequent characters get the deepest ones.
+    unsigned available = 1,used = 0,depth = 0;
+    int internal = count - 2;
+    int position = count - 1;
+    while(available > 0){
+        while(internal >= 0 && a[internal] == depth){
+            ++used;
+            --internal;
+        }
+        while(available > used){
+            a[position--] = depth;
+            --available;
+        }
+        available = 2 * used;
+        ++depth;
+        used = 0;
+    }
+}
+
+//The package-merge algorithm treats each character as a set of coins, one for each length from 1 to max_length,
+//whose value is the character's frequency and whose width is 2^-length.  Choosing the cheapest coins whose widths
+//add up to the number of characters minus 1 and giving each character one bit for each of its coins that was chosen
+//yields the optimal lengths.  The coins are chosen from the narrowest up: at each width, the cheapest items of the
+//width below are paired into packages, which are merged with the coins of that width.
+void code_builder::package_merge(unsigned count,unsigned max_length){
+    //The narrowest list holds only coins.
+    std::copy(frequencies.begin(),frequencies.begin() + count,items[0].begin());
+    std::fill(packages[0].begin(),packages[0].begin() + count,false);
+    unsigned size = count;
+    for(unsigned level = 1;level < max_length;++level){
+        const auto& below = items[(level - 1) & 1];
+        auto& list = items[level & 1];
+        unsigned package_count = size / 2;
+        unsigned coin = 0,package = 0;
+        size = 0;
+        while(coin < count || package < package_count){
+            uint64_t package_frequency = package < package_count ? below[2 * package] + below[2 * package + 1] : 0;
+            //Coins come before packages of the same frequency.
+            if(package == package_count || (coin < count && frequencies[coin] <= package_frequency)){
+                list[size] = frequencies[coin++];
+                packages[level][size++] = false;
+            }else{
+                list[size] = package_frequency;
+                ++package;
+                packages[level][size++] = true;
+            }
+        }
+    }
+
+    //Two items of width 2^-1 are chosen for every character but one.  Each package that is chosen means that the two
+    //items it was made of are chosen from the list below, and those are always the first items of that list.  The
+    //coins of each list are in the order of the characters, so the coins that are chosen belong to the least
+    //frequent characters.
+    std::fill(depths.begin(),depths.begin() + count,0);
+    unsigned chosen = 2 * count - 2;
+    for(unsigned level = max_length;level-- > 0 && chosen > 0;){
+        unsigned package_count = 0;
+        for(unsigned item = 0;item < chosen;++item){
+            package_count += packages[level][item];
+        }
+        for(unsigned coin = 0;coin < chosen - package_count;++coin){
+            depths[coin]++;
+        }
+        chosen = 2 * package_count;
+    }
+}
@@ -0,0 +1,69 @@
+/*
+This file defines the class that computes the length of each character's bitstring in a Huffman encoding.  It works
+on flat arrays that belong to the object, so computing the lengths allocates no memory, and a single object can be
+reused to build the encoding of every block of a file.
+
+The characters are sorted by frequency, and the lengths are computed in place in the array of sorted frequencies
+(the algorithm of Moffat and Katajainen), which builds the tree with two queues: one of the characters that were not
+used yet, and one of the internal nodes, whose frequencies are created in increasing order.  When the tree is deeper
+than the limit on the length of the bitstrings, the lengths are recomputed with the package-merge algorithm.
+*/
+#ifndef CODE_BUILDER_H_
+#define CODE_BUILDER_H_
+#include <array>
+#include <cstdint>
+#include "encode_table.h"
+#include "type_defs.h"
+
+//The longest bitstring allowed by default.  With it, every bitstring is decoded by a single lookup in the root of a
+//decode_table, whose 2^11 entries take 16 KiB and stay in the L1 cache.
+const unsigned DEFAULT_MAX_CODE_LENGTH = 11;
+//The number of bits that characters take when they are encoded with the optimal lengths, and with the lengths
+//limited to a maximum.
+struct limit_cost{
+    uint64_t optimal_bits;
+    uint64_t limited_bits;
+};
+
+class code_builder{
+public:
+    //The longest bitstring that the lengths can be limited to.
+    const static unsigned MAX_LENGTH = encode_table::MAX_LENGTH;
+    //The shortest limit that leaves room for a bitstring for each of the 256 characters.
+    const static unsigned MIN_MAX_LENGTH = 8;
+
+    //Returns whether the bitstrings can be limited to max_length bits whatever characters occur.
+    static bool valid_max_length(unsigned max_length){
+        return max_length >= MIN_MAX_LENGTH && max_length <= MAX_LENGTH;
+    }
+
+    //Computes the lengths of the Huffman encoding for the frequencies.  Every character that occurs has a length of
+    //at least 1, and the others have a length of 0.
+    void build(const frequency_table&,code_lengths&);
+    //Computes the lengths of the optimal encoding among those whose bitstrings are at most max_length bits long.
+    //max_length must be valid (see valid_max_length).  If cost is not nullptr, the number of bits that the characters
+    //take with and without the limit is added to it.
+    void build(const frequency_table&,unsigned max_length,code_lengths&,limit_cost* cost = nullptr);
+
+private:
+    //Sorts the characters that occur by frequency.  Returns the number of them.
+    unsigned sort_characters(const frequency_table&);
+    //Sorts the characters and computes their optimal lengths in depths.  Returns the number of characters.
+    unsigned optimal_lengths(const frequency_table&);
+    //Replaces the sorted frequencies of the first count characters in depths with the lengths of their bitstrings.
+    void minimum_redundancy(unsigned count);
+    //Sets the lengths of the first count sorted characters in depths, limited to max_length.
+    void package_merge(unsigned count,unsigned max_length);
+
+    //The characters that occur, from the least frequent to the most frequent, and their frequencies.
+    std::array<unsigned char,256> characters;
+    std::array<uint64_t,256> frequencies;
+    //The array in which the lengths of the sorted characters are computed.
+    std::array<uint64_t,256> depths;
+    //The frequencies of the items of two consecutive lists of package-merge, and, for every list, whether each of its
+    //items is a package.
+    std::array<uint64_t,512> items[2];
+    std::array<std::array<bool,512>,MAX_LENGTH> packages;
+};
+
+#endif // CODE_BUILDER_H_
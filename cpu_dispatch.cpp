@@ -0,0 +1,54 @@
+#include "cpu_dispatch.h"
+#include <cstring>
+
+static const char* const VARIANT_NAMES[VARIANT_COUNT] = {"scalar","bmi2","avx2"};
+
+//Asks the processor, through cpuid, which instructions it has.  __builtin_cpu_supports also checks that the operating
+//system saves the AVX registers.
+static cpu_variant detect_variant(){
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("bmi2")){
+        if(__builtin_cpu_supports("avx2"))
+            return AVX2_VARIANT;
+        return BMI2_VARIANT;
+    }
+#endif
+    return SCALAR_VARIANT;
+}
+
+cpu_variant supported_variant(){
+    static const cpu_variant supported = detect_variant();
+    return supported;
+}
+
+//The variant that was chosen.  It is only changed by force_variant, before the work starts.
+static cpu_variant& selected_variant(){
+    static cpu_variant selected = supported_variant();
+    return selected;
+}
+
+cpu_variant active_variant(){
+    return selected_variant();
+}
+
+bool force_variant(cpu_variant variant){
+    if(variant >= VARIANT_COUNT || variant > supported_variant())
+        return false;
+    selected_variant() = variant;
+    return true;
+}
+
+const char* variant_name(cpu_variant variant){
+    return variant < VARIANT_COUNT ? VARIANT_NAMES[variant] : "unknown";
+}
+
+bool parse_variant(const char* name,cpu_variant& variant){
+    for(unsigned candidate = 0;candidate < VARIANT_COUNT;++candidate){
+        if(strcmp(name,VARIANT_NAMES[candidate]) == 0){
+            variant = static_cast<cpu_variant>(candidate);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,36 @@
+/*
+This file selects which variant of the hot loops is run: packing bitstrings in obitstream::encode, extracting them in
+ibitstream::decode, and counting characters in the histogram class.  Each of those loops is compiled several times
+in the same binary, once for any x86-64 processor and once for each of the instruction sets below, and the variant is
+chosen at run time from what the processor reports through cpuid, so a single binary runs at full speed on old and
+new processors alike.  The choice is made once, the first time it is needed, and can be overridden to compare the
+variants.
+*/
+#ifndef CPU_DISPATCH_H_
+#define CPU_DISPATCH_H_
+
+//The variants, each of which requires the instructions of the ones before it.
+enum cpu_variant{
+    //Plain x86-64 (or whatever the compiler targets on other processors).
+    SCALAR_VARIANT,
+    //BMI2, whose shlx and shrx shift the bit buffers without the flags and the fixed count register of the plain
+    //shifts.
+    BMI2_VARIANT,
+    //AVX2 on top of BMI2, whose 32-byte compares let the histogram count runs of a character in one step.
+    AVX2_VARIANT,
+    VARIANT_COUNT
+};
+
+//The best variant that the processor supports.
+cpu_variant supported_variant();
+//The variant that the loops run.  It is the supported one unless force_variant was called.
+cpu_variant active_variant();
+//Makes the loops run the variant.  Returns false, leaving the variant unchanged, if the processor does not support
+//it.  It should be called before any thread starts compressing or decompressing.
+bool force_variant(cpu_variant variant);
+//The name of the variant, as accepted by parse_variant.
+const char* variant_name(cpu_variant variant);
+//Finds the variant with the name.  Returns false if there is none.
+bool parse_variant(const char* name,cpu_variant& variant);
+
+#endif // CPU_DISPATCH_H_
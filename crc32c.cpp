@@ -0,0 +1,78 @@
+#include "crc32c.h"
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#endif
+
+//The reversed Castagnoli polynomial.
+const uint32_t POLYNOMIAL = 0x82f63b78;
+
+//The slice-by-8 tables.  tables[0] is the usual table for one byte; tables[k] gives the effect of a byte that is
+//followed by k more bytes, so 8 bytes are folded into the checksum with 8 independent lookups.
+struct slice_tables{
+    uint32_t tables[8][256];
+    slice_tables(){
+        for(unsigned byte = 0;byte < 256;++byte){
+            uint32_t crc = byte;
+            for(unsigned bit = 0;bit < 8;++bit){
+                crc = crc & 1 ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+            }
+            tables[0][byte] = crc;
+        }
+        for(unsigned byte = 0;byte < 256;++byte){
+            for(unsigned slice = 1;slice < 8;++slice){
+                uint32_t previous = tables[slice - 1][byte];
+                tables[slice][byte] = (previous >> 8) ^ tables[0][previous & 0xff];
+            }
+        }
+    }
+};
+
+static uint32_t crc32c_slice8(const unsigned char* data,size_t size,uint32_t crc){
+    static const slice_tables slices;
+    const uint32_t (&tables)[8][256] = slices.tables;
+    for(;size >= 8;data += 8,size -= 8){
+        //The first 4 bytes are combined with the checksum so far, as the slice-by-8 algorithm does on
+        //little-endian machines.
+        uint32_t low = (data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24) ^ crc;
+        crc = tables[7][low & 0xff] ^ tables[6][(low >> 8) & 0xff] ^ tables[5][(low >> 16) & 0xff] ^
+            tables[4][low >> 24] ^ tables[3][data[4]] ^ tables[2][data[5]] ^ tables[1][data[6]] ^ tables[0][data[7]];
+    }
+    for(;size > 0;++data,--size){
+        crc = (crc >> 8) ^ tables[0][(crc ^ *data) & 0xff];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(const unsigned char* data,size_t size,uint32_t crc){
+    uint64_t crc64 = crc;
+    for(;size >= 8;data += 8,size -= 8){
+        uint64_t word;
+        memcpy(&word,data,sizeof(word));
+        crc64 = _mm_crc32_u64(crc64,word);
+    }
+    crc = crc64;
+    for(;size > 0;++data,--size){
+        crc = _mm_crc32_u8(crc,*data);
+    }
+    return crc;
+}
+#endif
+
+typedef uint32_t (*crc_function)(const unsigned char*,size_t,uint32_t);
+
+static crc_function select_crc(){
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("sse4.2"))
+        return crc32c_sse42;
+#endif
+    return crc32c_slice8;
+}
+
+uint32_t crc32c(const unsigned char* data,size_t size,uint32_t crc){
+    static const crc_function implementation = select_crc();
+    //The checksum is kept inverted while it is computed.
+    return ~implementation(data,size,~crc);
+}
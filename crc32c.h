@@ -0,0 +1,16 @@
+/*
+This file declares the function that computes CRC32C checksums (the Castagnoli polynomial, as used by iSCSI and ext4),
+which detect corruption in blocks.  On x86 processors with SSE4.2 the checksum is computed with the crc32 instruction,
+8 bytes at a time; on other processors it is computed 8 bytes at a time with the slice-by-8 tables.  The choice is
+made once, the first time a checksum is computed.
+*/
+#ifndef CRC32C_H_
+#define CRC32C_H_
+#include <cstddef>
+#include <cstdint>
+
+//Returns the checksum of the data.  The checksum of data that is split into pieces can be computed by passing the
+//checksum of the previous pieces as crc.
+uint32_t crc32c(const unsigned char* data,size_t size,uint32_t crc = 0);
+
+#endif // CRC32C_H_
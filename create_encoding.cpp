@@ -1,94 +1,70 @@
 #include "create_encoding.h"
-#include <vector>
-#include <queue>
-#include <functional>
 #include <algorithm>
 #include <utility>
-using std::pair;
-using std::priority_queue;
-using std::vector;
 
-//Represents a node in the tree that is used to determine the encoding.  Is only used inside this file.
-struct Node{
-    char character;
-    //The combined frequency of all of its children
-    size_t frequency;
-    Node* zero;
-    Node* one;
-    bool operator<(const Node& rhs){
-        return frequency < rhs.frequency;
-    }
-    Node(char value,size_t frequency)
-        :character(value),frequency(frequency),zero(nullptr),one(nullptr)
-        {}
-    Node(size_t frequency,Node* zero,Node* one)
-        :character('\0'),frequency(frequency),zero(zero),one(one)
-        {}
-};
-
-
-encoding_t transverse(Node*);
 encoding_t create_encoding(unordered_map<char,size_t> frequencies){
-    //The priority queue is sorted by frequency, so the node less frequency will be on top.
-    priority_queue<Node*,std::vector<Node*>,std::function<bool(Node*,Node*)> > frequency_queue(
-            [](Node* a,Node* b){return *b < *a;},
-            std::vector<Node*>());
+    return canonical_encoding(create_code_lengths(frequencies));
+}
 
-    //Create nodes for each character with the character and its frequency.
-    for(auto cFrequency:frequencies){
-        frequency_queue.push(new Node(cFrequency.first,cFrequency.second));
+code_lengths create_code_lengths(const unordered_map<char,size_t>& frequencies){
+    frequency_table table;
+    table.fill(0);
+    for(auto& c_frequency:frequencies){
+        table[static_cast<unsigned char>(c_frequency.first)] = c_frequency.second;
     }
+    return create_code_lengths(table);
+}
+
+code_lengths create_code_lengths(const frequency_table& frequencies){
+    code_builder builder;
+    code_lengths lengths;
+    builder.build(frequencies,lengths);
+    return lengths;
+}
 
-    //Reduce the size of the priority queue to 1 by removing the least frequent two nodes, combining them under one
-    //parent, and inserting that into the queue, thereby constructing a tree.
-    while(frequency_queue.size() > 1){
-        Node* nodeA = frequency_queue.top();
-        frequency_queue.pop();
-        Node* nodeB = frequency_queue.top();
-        frequency_queue.pop();
+code_lengths create_code_lengths(const frequency_table& frequencies,unsigned max_length,limit_cost* cost){
+    code_builder builder;
+    code_lengths lengths;
+    builder.build(frequencies,max_length,lengths,cost);
+    return lengths;
+}
 
-        //The new node's frequency should be the sum of the frequency of its children.
-        Node* parent = new Node(nodeA->frequency + nodeB->frequency,nodeA,nodeB);
-        frequency_queue.push(parent);
+std::array<uint64_t,256> canonical_codes(const code_lengths& lengths){
+    std::array<uint64_t,256> codes;
+    codes.fill(0);
+    //Count the characters of each length, in order to find the first code of each length.
+    std::array<uint64_t,256> length_count;
+    length_count.fill(0);
+    for(auto length:lengths){
+        length_count[length]++;
     }
-    //The remaining node in the heap is the root of the tree.  Transverse the tree in order to obtain the encoding.
-    Node* tree = frequency_queue.top();
-    encoding_t encoding =  transverse(tree);
-    //Since transverse calls push_back rather than push_front, the bitstrings have to be reversed.
-    //Since transverse calls push_back rather than push_front, the bitstrings have to be reversed.
-    for(auto iter = encoding.begin();iter != encoding.end();++iter){
-        std::reverse(iter->second.begin(),iter->second.end());
+    length_count[0] = 0;
+    //The first code of each length is the code after the last code of the previous length, with a 0 appended.
+    std::array<uint64_t,256> next_code;
+    next_code[0] = 0;
+    for(unsigned length = 1;length < length_count.size();++length){
+        next_code[length] = (next_code[length - 1] + length_count[length - 1]) << 1;
     }
-    return encoding;
+    for(unsigned character = 0;character < lengths.size();++character){
+        if(lengths[character] != 0){
+            codes[character] = next_code[lengths[character]]++;
+        }
+    }
+    return codes;
 }
 
-//This function transverses the tree, constructing an encoding based on which ancestors are one branches and which
-//are zero branches. It deallocates nodes as it goes.
-encoding_t transverse(Node* node){
-    //For a branch node, recursively call this function to obtain the hashtable for both of its children, then append
-    //1 to the bitstrings from the one branch and 0 to the bitstrings from the zero branch, then merge the branches
-    //by inserting the map for the one branch into the one for the zero branch.
-
-    if(node->one){  //If one of the children is not empty then it is a branch.  one was chosen arbitrarily.
-            auto zeroes = transverse(node->zero);
-            for(auto iter = zeroes.begin();iter != zeroes.end();++iter){
-                //The zero should have been appended to the beginning, but vector is used bitstring for greater
-                //efficiency.  The create_encoding function will reverse the bitstrings.
-                iter->second.push_back(false);
-            }
-            auto ones = transverse(node->one);
-            for(auto iter = ones.begin();iter != ones.end();++iter){
-                iter->second.push_back(true);
-            }
-            zeroes.insert(ones.begin(),ones.end());
-            delete node;
-            return zeroes;
-    //If the node is a leaf then make a new map with the character and an empty bitstring.
-    }else{
-        encoding_t retval({std::make_pair(node->character,bitstring())});
-
-        delete node;
-        return retval;
+encoding_t canonical_encoding(const code_lengths& lengths){
+    encoding_t encoding;
+    auto codes = canonical_codes(lengths);
+    for(unsigned character = 0;character < lengths.size();++character){
+        if(lengths[character] == 0)
+            continue;
+        //Write the bits of the code to the bitstring starting from the most significant one.
+        bitstring representation(lengths[character]);
+        for(unsigned position = 0;position < lengths[character];++position){
+            representation[position] = (codes[character] >> (lengths[character] - 1 - position)) & 1;
+        }
+        encoding.insert(std::make_pair(static_cast<char>(character),representation));
     }
+    return encoding;
 }
-
@@ -2,12 +2,31 @@
 #define CREATE_ENCODING_H_INCLUDED
 #include <unordered_map>
 #include <deque>
+#include <cstdint>
 #include "type_defs.h"
+#include "code_builder.h"
 using std::deque;
 using std::unordered_map;
 
-//Takes a map mapping characters to frequencies, and constructs an encoding based on it.
+//Takes a map mapping characters to frequencies, and constructs an encoding based on it.  The encoding is canonical,
+//so it can be rebuilt from the lengths of its bitstrings.
 encoding_t create_encoding(unordered_map<char,size_t>);
+//Takes a map mapping characters to frequencies, and returns the length of each character's bitstring in the Huffman
+//encoding for those frequencies.  Every character that occurs has a length of at least 1.
+code_lengths create_code_lengths(const unordered_map<char,size_t>&);
+code_lengths create_code_lengths(const frequency_table&);
+
+//Returns the lengths of the optimal encoding among those whose bitstrings are at most max_length bits long.
+//max_length must be large enough for every character to have a bitstring, which 8 always is.  If cost is not
+//nullptr, the number of bits that the characters take with and without the limit is added to it.  Code that builds
+//many encodings can keep a code_builder and call it directly instead.
+code_lengths create_code_lengths(const frequency_table&,unsigned max_length,limit_cost* cost = nullptr);
+//Returns the canonical bitstring of each character as a number, with the first bit of the bitstring in the most
+//significant of its length bits.  Characters with the same length are assigned consecutive numbers in the order of
+//the characters, and shorter bitstrings come before longer ones.
+std::array<uint64_t,256> canonical_codes(const code_lengths&);
+//Constructs the canonical encoding with the given lengths.
+encoding_t canonical_encoding(const code_lengths&);
 
 
 #endif // CREATE_ENCODING_H_INCLUDED
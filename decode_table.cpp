@@ -0,0 +1,110 @@
+#include "decode_table.h"
+#include <algorithm>
+#include <map>
+#include "create_encoding.h"
+
+//The sizes are passed to std::min by reference, which needs them to be defined somewhere.
+const unsigned decode_table::ROOT_BITS;
+const unsigned decode_table::SUB_BITS;
+
+decode_table::decode_table()
+    :root_bits_(1),
+    max_length_(0),
+    entries_(2,decode_entry())
+    {}
+
+decode_table::decode_table(const decoding_t& encoding)
+    :root_bits_(1),
+    max_length_(0)
+    {
+    build(encoding);
+}
+
+decode_table::decode_table(const code_lengths& lengths)
+    :root_bits_(1),
+    max_length_(0)
+    {
+    build(lengths);
+}
+
+void decode_table::build(const decoding_t& encoding){
+    //Convert each bitstring to a number, with the first bit of the bitstring in the least significant bit, since
+    //that is the order in which the bits are read from the stream.
+    codes.clear();
+    for(auto& c_pair:encoding){
+        code c_code = {0,static_cast<unsigned>(c_pair.first.size()),static_cast<unsigned char>(c_pair.second)};
+        for(unsigned position = 0;position < c_code.length;++position){
+            c_code.bits |= static_cast<uint64_t>(c_pair.first[position]) << position;
+        }
+        codes.push_back(c_code);
+    }
+    build();
+}
+
+void decode_table::build(const code_lengths& lengths){
+    auto canonical = canonical_codes(lengths);
+    codes.clear();
+    for(unsigned character = 0;character < lengths.size();++character){
+        if(lengths[character] == 0)
+            continue;
+        //Canonical codes are numbered with the first bit in the most significant position, so they are reversed.
+        code c_code = {0,lengths[character],static_cast<unsigned char>(character)};
+        for(unsigned position = 0;position < c_code.length;++position){
+            c_code.bits |= ((canonical[character] >> (c_code.length - 1 - position)) & 1) << position;
+        }
+        codes.push_back(c_code);
+    }
+    build();
+}
+
+void decode_table::build(){
+    max_length_ = 0;
+    for(auto& c_code:codes){
+        max_length_ = std::max(max_length_,c_code.length);
+    }
+    //The root table does not have to be wider than the longest bitstring.
+    root_bits_ = std::max(1u,std::min(max_length_,ROOT_BITS));
+    //Assigning to the vector reuses its memory, so rebuilding a table with no sub-tables does not allocate.
+    entries_.assign(static_cast<size_t>(1) << root_bits_,decode_entry());
+    fill(codes,0,root_bits_);
+}
+
+void decode_table::fill(const std::vector<code>& codes,size_t base,unsigned bits){
+    //Codes that are longer than the table is wide are grouped by their first bits, each group goes in a sub-table.
+    std::map<uint64_t,std::vector<code> > long_codes;
+    for(auto& c_code:codes){
+        //An empty bitstring cannot be decoded, since it would not consume any bits.
+        if(c_code.length == 0)
+            continue;
+        if(c_code.length <= bits){
+            //The bits after the bitstring can be anything, so every entry whose index starts with the bitstring
+            //decodes to the character.
+            for(uint64_t suffix = 0;suffix < (static_cast<uint64_t>(1) << (bits - c_code.length));++suffix){
+                decode_entry& entry = entries_[base + (c_code.bits | suffix << c_code.length)];
+                entry.value = c_code.character;
+                entry.length = c_code.length;
+                entry.sub_bits = 0;
+            }
+        }else{
+            //Strip the bits that index this table from the code before it goes in the sub-table.
+            code remainder = {c_code.bits >> bits,c_code.length - bits,c_code.character};
+            long_codes[c_code.bits & ((static_cast<uint64_t>(1) << bits) - 1)].push_back(remainder);
+        }
+    }
+    for(auto& group:long_codes){
+        unsigned longest = 0;
+        for(auto& c_code:group.second){
+            longest = std::max(longest,c_code.length);
+        }
+        unsigned sub_bits = std::min(longest,SUB_BITS);
+        //Append the sub-table to the table and link to it.  The entry is accessed by position, since the
+        //vector is reallocated when it grows.
+        size_t sub_base = entries_.size();
+        entries_.resize(sub_base + (static_cast<size_t>(1) << sub_bits),decode_entry());
+        decode_entry& link = entries_[base + group.first];
+        link.value = sub_base;
+        link.length = bits;
+        link.sub_bits = sub_bits;
+        fill(group.second,sub_base,sub_bits);
+    }
+}
@@ -0,0 +1,68 @@
+/*
+This file defines the lookup table that the ibitstream class uses to decode characters.  Instead of extracting one
+bit at a time until the bits form a valid bitstring, the decoder peeks at the next root_bits bits of the stream and
+uses them as an index into the root table.  The entry it finds holds the decoded character and the length of its
+bitstring, so a character is decoded with a single array access.  Bitstrings that are longer than root_bits are
+handled by linking the entry for their first root_bits bits to a sub-table which is indexed by the following bits.
+*/
+#ifndef DECODE_TABLE_H_
+#define DECODE_TABLE_H_
+#include <cstdint>
+#include <vector>
+#include "type_defs.h"
+
+//An entry in a decode_table.  An entry whose length is 0 does not correspond to any bitstring, so reaching it means
+//that the stream contains an invalid sequence.
+struct decode_entry{
+    //For a leaf, the decoded character.  For a link, the position of the sub-table in the table.
+    uint32_t value;
+    //The number of bits that are consumed by this entry.
+    uint8_t length;
+    //0 for a leaf, otherwise the number of bits used to index the sub-table.
+    uint8_t sub_bits;
+};
+
+class decode_table{
+public:
+    //The maximum number of bits used to index the root table and each sub-table.
+    const static unsigned ROOT_BITS = 11;
+    const static unsigned SUB_BITS = 8;
+
+    //Constructs an empty table, in which every sequence is invalid.
+    decode_table();
+    //Constructs the table for the encoding.
+    explicit decode_table(const decoding_t&);
+    //Constructs the table for the canonical encoding with the given lengths.
+    explicit decode_table(const code_lengths&);
+    //Rebuilds the table for the encoding.
+    void build(const decoding_t&);
+    //Rebuilds the table for the canonical encoding with the given lengths.
+    void build(const code_lengths&);
+
+    //The number of bits used to index the root table.
+    unsigned root_bits() const {return root_bits_;}
+    //The length of the longest bitstring in the encoding.
+    unsigned max_length() const {return max_length_;}
+    const decode_entry* entries() const {return entries_.data();}
+
+private:
+    //A bitstring stored as a number, with the first bit of the bitstring in the least significant bit.
+    struct code{
+        uint64_t bits;
+        unsigned length;
+        unsigned char character;
+    };
+    //Rebuilds the table for the codes in the codes member.
+    void build();
+    //Fills the table of size 2^bits that starts at base with the codes, creating sub-tables for codes that are
+    //longer than bits.
+    void fill(const std::vector<code>& codes,size_t base,unsigned bits);
+
+    unsigned root_bits_;
+    unsigned max_length_;
+    std::vector<decode_entry> entries_;
+    //The codes that the table is built from.  They are kept so that rebuilding the table reuses their memory.
+    std::vector<code> codes;
+};
+
+#endif // DECODE_TABLE_H_
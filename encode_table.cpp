@@ -0,0 +1,30 @@
+#include "encode_table.h"
+#include "create_encoding.h"
+
+encode_table::encode_table()
+    :max_length_(0)
+    {
+    entries_.fill(0);
+}
+
+encode_table::encode_table(const code_lengths& lengths)
+    :max_length_(0)
+    {
+    build(lengths);
+}
+
+void encode_table::build(const code_lengths& lengths){
+    auto codes = canonical_codes(lengths);
+    max_length_ = 0;
+    for(unsigned character = 0;character < lengths.size();++character){
+        unsigned length = lengths[character];
+        //Canonical codes are numbered with the first bit in the most significant position, so they are reversed.
+        uint64_t reversed = 0;
+        for(unsigned position = 0;position < length;++position){
+            reversed |= ((codes[character] >> (length - 1 - position)) & 1) << position;
+        }
+        entries_[character] = reversed << LENGTH_BITS | length;
+        if(length > max_length_)
+            max_length_ = length;
+    }
+}
@@ -0,0 +1,36 @@
+/*
+This file defines the table that the obitstream class uses to encode characters.  For each of the 256 characters it
+holds the character's bitstring and the bitstring's length, packed into a single 64 bit number, so encoding a
+character takes one array access instead of looking up a bitstring in a map.
+*/
+#ifndef ENCODE_TABLE_H_
+#define ENCODE_TABLE_H_
+#include <array>
+#include <cstdint>
+#include "type_defs.h"
+
+class encode_table{
+public:
+    //The number of low bits of each entry that hold the length.  The bitstring is in the bits above them.
+    const static unsigned LENGTH_BITS = 6;
+    //The longest bitstring that fits in an entry.
+    const static unsigned MAX_LENGTH = 64 - LENGTH_BITS;
+
+    //Constructs a table in which every character has an empty bitstring.
+    encode_table();
+    //Constructs the table for the canonical encoding with the given lengths, which must be at most MAX_LENGTH.
+    explicit encode_table(const code_lengths&);
+    void build(const code_lengths&);
+
+    //The entry of each character: the bitstring, with its first bit in the least significant position (the order in
+    //which the bits are written), shifted left by LENGTH_BITS, plus the length.
+    const uint64_t* entries() const {return entries_.data();}
+    //The length of the longest bitstring.
+    unsigned max_length() const {return max_length_;}
+
+private:
+    std::array<uint64_t,256> entries_;
+    unsigned max_length_;
+};
+
+#endif // ENCODE_TABLE_H_
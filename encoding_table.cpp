@@ -5,6 +5,7 @@
 #include <utility>
 #include <iostream>
 #include <unordered_map>
+#include "encode_table.h"
 
 void write_table(std::ofstream& destination,const encoding_t& encoding){
     //Determine the longest bit string in the encoding.
@@ -40,18 +41,22 @@ void write_table(std::ofstream& destination,const encoding_t& encoding){
 }
 
 
-decoding_t read_table(std::ifstream& source){
+decoding_t read_table(std::istream& source){
     decoding_t retval;
 
     //The first character of the file is the number of bits in each encoding.
     char max_length;
     source.read(&max_length,1);
     //The first character in the table is the signal that will be used for the end of the table.
-    unsigned char first_char = source.peek();
+    char first_char = source.peek();
     char* buffer = new char[max_length];
     //For each entry in the table, write the character and the sequence of bits to the map.
     while(true){
         char character = source.get();
+        //If the end of the file was reached in the middle of the table then the file is truncated.
+        if(!source){
+            break;
+        }
 
         //The repetition of the first character from the table is the signal that the table is over.
         if(!retval.empty() && character == first_char){
@@ -79,4 +84,208 @@ decoding_t read_table(std::ifstream& source){
     return retval;
 }
 
+/*
+The table of lengths starts with the length of the longest bitstring.  If it is 0 then the encoding is empty and the
+table ends there.  Otherwise, the next byte holds the number of characters in the encoding minus 1, followed by the
+characters themselves.  When there are fewer than 32 characters they are listed, one per byte, in increasing order.
+Otherwise, they are represented by 32 bytes in which each bit is set if the corresponding character is in the
+encoding.  Last come the lengths of the characters' bitstrings minus 1, in the same order, packed into as few bits as
+are needed to store the longest one.
+*/
+const unsigned LIST_LIMIT = 32;
+
+//The number of bits needed to store the length of each bitstring minus 1.
+static unsigned length_width(unsigned max_length){
+    unsigned width = 0;
+    while((1u << width) < max_length){
+        ++width;
+    }
+    return width;
+}
 
+void write_lengths(std::vector<unsigned char>& destination,const code_lengths& lengths){
+    unsigned max_length = *std::max_element(lengths.begin(),lengths.end());
+    destination.push_back(max_length);
+    if(max_length == 0)
+        return;
+    std::array<unsigned char,256> characters;
+    unsigned count = 0;
+    for(unsigned character = 0;character < lengths.size();++character){
+        if(lengths[character] != 0)
+            characters[count++] = character;
+    }
+    destination.push_back(count - 1);
+    if(count < LIST_LIMIT){
+        destination.insert(destination.end(),characters.begin(),characters.begin() + count);
+    }else{
+        size_t bitmap = destination.size();
+        destination.resize(bitmap + lengths.size() / 8,0);
+        for(unsigned position = 0;position < count;++position){
+            destination[bitmap + characters[position] / 8] |= 1 << (characters[position] % 8);
+        }
+    }
+    //Pack the lengths, starting from the least significant bit of each byte.
+    unsigned width = length_width(max_length);
+    unsigned accumulator = 0;
+    unsigned bits = 0;
+    for(unsigned position = 0;position < count;++position){
+        unsigned char character = characters[position];
+        accumulator |= (lengths[character] - 1u) << bits;
+        bits += width;
+        while(bits >= 8){
+            destination.push_back(accumulator & 0xff);
+            accumulator >>= 8;
+            bits -= 8;
+        }
+    }
+    if(bits > 0)
+        destination.push_back(accumulator);
+}
+
+void write_lengths(std::ostream& destination,const code_lengths& lengths){
+    std::vector<unsigned char> buffer;
+    write_lengths(buffer,lengths);
+    destination.write(reinterpret_cast<const char*>(buffer.data()),buffer.size());
+}
+
+//Returns the number of bytes in a table of lengths of count characters, the longest of which is max_length.
+static size_t table_size(size_t count,unsigned max_length){
+    size_t characters_size = count < LIST_LIMIT ? count : 256 / 8;
+    return 2 + characters_size + (count * length_width(max_length) + 7) / 8;
+}
+
+//Returns the number of bytes in a table of lengths, given its first bytes, or 0 if more of the table is needed to
+//determine its size.  available is the number of bytes of the table that are known.
+static size_t lengths_size(const unsigned char* source,size_t available){
+    if(available < 1)
+        return 0;
+    if(source[0] == 0)
+        return 1;
+    if(available < 2)
+        return 0;
+    return table_size(source[1] + 1,source[0]);
+}
+
+size_t lengths_bound(unsigned characters,unsigned max_length){
+    return characters == 0 ? 1 : table_size(characters,max_length);
+}
+
+const unsigned char* read_lengths(const unsigned char* source,const unsigned char* end,code_lengths& lengths){
+    lengths.fill(0);
+    size_t size = lengths_size(source,end - source);
+    if(size == 0 || size > static_cast<size_t>(end - source))
+        return nullptr;
+    unsigned max_length = source[0];
+    if(max_length == 0)
+        return source + 1;
+    //Longer bitstrings do not fit in the tables that are built from the lengths.
+    if(max_length > encode_table::MAX_LENGTH)
+        return nullptr;
+    size_t count = source[1] + 1;
+    const unsigned char* position = source + 2;
+    std::array<unsigned char,256> characters;
+    size_t found = 0;
+    if(count < LIST_LIMIT){
+        std::copy(position,position + count,characters.begin());
+        found = count;
+        position += count;
+    }else{
+        for(unsigned character = 0;character < lengths.size();++character){
+            if(position[character / 8] & (1 << (character % 8)))
+                characters[found++] = character;
+        }
+        position += lengths.size() / 8;
+    }
+    if(found != count)
+        return nullptr;
+    //Unpack the lengths.
+    unsigned width = length_width(max_length);
+    unsigned accumulator = 0;
+    unsigned bits = 0;
+    for(size_t index = 0;index < count;++index){
+        unsigned char character = characters[index];
+        while(bits < width){
+            accumulator |= static_cast<unsigned>(*position++) << bits;
+            bits += 8;
+        }
+        unsigned length = (accumulator & ((1u << width) - 1)) + 1;
+        //The width can hold lengths up to the next power of two, which would escape the check below.
+        if(length > max_length)
+            return nullptr;
+        lengths[character] = length;
+        accumulator >>= width;
+        bits -= width;
+    }
+    //Make sure that the lengths form a prefix code by checking that, for each length, there are no more bitstrings
+    //of that length than there are unused bitstrings left.  Once the number left exceeds the number of characters,
+    //it can no longer run out.
+    std::array<unsigned,256> length_count;
+    length_count.fill(0);
+    for(auto length:lengths){
+        length_count[length]++;
+    }
+    size_t left = 1;
+    for(unsigned length = 1;length <= max_length;++length){
+        left = std::min<size_t>(left * 2,2 * lengths.size());
+        if(length_count[length] > left)
+            return nullptr;
+        left -= length_count[length];
+    }
+    return source + size;
+}
+
+bool read_lengths(std::istream& source,code_lengths& lengths){
+    //Read the beginning of the table until its size is known, then read the rest of it.
+    std::vector<unsigned char> buffer;
+    size_t size;
+    while((size = lengths_size(buffer.data(),buffer.size())) == 0){
+        int byte = source.get();
+        if(!source)
+            return false;
+        buffer.push_back(byte);
+    }
+    size_t read = buffer.size();
+    buffer.resize(size);
+    source.read(reinterpret_cast<char*>(buffer.data() + read),size - read);
+    if(!source)
+        return false;
+    return read_lengths(buffer.data(),buffer.data() + buffer.size(),lengths) != nullptr;
+}
+
+void write_number(std::vector<unsigned char>& destination,uint64_t number){
+    while(number >= 0x80){
+        destination.push_back((number & 0x7f) | 0x80);
+        number >>= 7;
+    }
+    destination.push_back(number);
+}
+
+void write_number(std::ostream& destination,uint64_t number){
+    std::vector<unsigned char> buffer;
+    write_number(buffer,number);
+    destination.write(reinterpret_cast<const char*>(buffer.data()),buffer.size());
+}
+
+const unsigned char* read_number(const unsigned char* source,const unsigned char* end,uint64_t& number){
+    number = 0;
+    for(unsigned shift = 0;source != end && shift < 64;shift += 7){
+        unsigned char byte = *source++;
+        number |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            return source;
+    }
+    return nullptr;
+}
+
+bool read_number(std::istream& source,uint64_t& number){
+    number = 0;
+    for(unsigned shift = 0;shift < 64;shift += 7){
+        int byte = source.get();
+        if(!source)
+            return false;
+        number |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
@@ -1,12 +1,35 @@
 #ifndef ENCODING_TABLE_H_
 #define ENCODING_TABLE_H_
+#include <cstdint>
 #include <fstream>
 #include <map>
+#include <vector>
 #include "type_defs.h"
 
 //Writes the table to the file.
 void write_table(std::ofstream& destination,const encoding_t& encoding);
 //Returns the table read from the file.
-decoding_t read_table(std::ifstream& source);
+decoding_t read_table(std::istream& source);
+
+//Appends a table of the lengths of the bitstrings of a canonical encoding to the buffer.
+void write_lengths(std::vector<unsigned char>& destination,const code_lengths& lengths);
+//Writes a table of the lengths of the bitstrings of a canonical encoding to the file.
+void write_lengths(std::ostream& destination,const code_lengths& lengths);
+//Reads a table of lengths from the buffer, and returns a pointer to the byte after it.  Returns nullptr if the table
+//is truncated or the lengths do not form a valid encoding.
+const unsigned char* read_lengths(const unsigned char* source,const unsigned char* end,code_lengths& lengths);
+//Reads a table of lengths from the file.  Returns false if the table is truncated or invalid.
+bool read_lengths(std::istream& source,code_lengths& lengths);
+//Returns the largest size of a table of lengths of the given number of characters, none of which is longer than
+//max_length.
+size_t lengths_bound(unsigned characters,unsigned max_length);
+
+//Appends a number to the buffer, using as few bytes as possible.  Each byte holds 7 bits of the number, starting
+//from the least significant ones, and its high bit is set if more bytes follow.
+void write_number(std::vector<unsigned char>& destination,uint64_t number);
+void write_number(std::ostream& destination,uint64_t number);
+//Reads a number written by write_number, returning a pointer to the byte after it or nullptr if it is truncated.
+const unsigned char* read_number(const unsigned char* source,const unsigned char* end,uint64_t& number);
+bool read_number(std::istream& source,uint64_t& number);
 
 #endif // ENCODING_TABLE_H_
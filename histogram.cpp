@@ -0,0 +1,149 @@
+#include "histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "cpu_dispatch.h"
+
+//The number of separate arrays of counts.  Consecutive characters are counted in different arrays, so that a run of
+//the same character does not make each increment wait for the previous one to be stored.
+const unsigned COUNTERS = 4;
+//The most characters that are counted in 32 bit counters before adding them to the totals.
+const size_t PIECE_SIZE = size_t(1) << 30;
+//The smallest part of a buffer that is worth counting on a separate thread.
+const size_t MIN_THREAD_SIZE = size_t(1) << 20;
+
+//Counts the characters of a word in the arrays of counters, two in each array.
+__attribute__((always_inline))
+static inline void count_word(uint64_t word,uint32_t (&counters)[COUNTERS][256]){
+    counters[0][word & 0xff]++;
+    counters[1][(word >> 8) & 0xff]++;
+    counters[2][(word >> 16) & 0xff]++;
+    counters[3][(word >> 24) & 0xff]++;
+    counters[0][(word >> 32) & 0xff]++;
+    counters[1][(word >> 40) & 0xff]++;
+    counters[2][(word >> 48) & 0xff]++;
+    counters[3][word >> 56]++;
+}
+
+//Counts the characters of a piece of the buffer, eight characters at a time.
+static void count_scalar(const unsigned char* data,const unsigned char* end,uint32_t (&counters)[COUNTERS][256]){
+    for(;end - data >= 8;data += 8){
+        uint64_t word;
+        memcpy(&word,data,sizeof(word));
+        count_word(word,counters);
+    }
+    for(;data != end;++data){
+        counters[0][*data]++;
+    }
+}
+
+#if defined(__x86_64__)
+//Counts the characters of a piece of the buffer, 32 characters at a time.  Each group is first compared with its
+//first character, and a group that holds a single character is counted with one addition.  Runs of a character are
+//the slowest input to count one at a time, since each increment has to wait for the previous one to be stored.
+__attribute__((target("avx2")))
+static void count_avx2(const unsigned char* data,const unsigned char* end,uint32_t (&counters)[COUNTERS][256]){
+    for(;end - data >= 32;data += 32){
+        __m256i group = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        __m256i first = _mm256_set1_epi8(static_cast<char>(data[0]));
+        if(_mm256_movemask_epi8(_mm256_cmpeq_epi8(group,first)) == -1){
+            counters[0][data[0]] += 32;
+            continue;
+        }
+        for(unsigned word_start = 0;word_start < 32;word_start += 8){
+            uint64_t word;
+            memcpy(&word,data + word_start,sizeof(word));
+            count_word(word,counters);
+        }
+    }
+    count_scalar(data,end,counters);
+}
+#endif
+
+//Adds the characters of the buffer to the frequencies.
+static void count_characters(const unsigned char* data,size_t size,frequency_table& frequencies){
+    auto count_piece = count_scalar;
+#if defined(__x86_64__)
+    //BMI2 has nothing to add to counting, so only the AVX2 variant has its own loop.
+    if(active_variant() >= AVX2_VARIANT)
+        count_piece = count_avx2;
+#endif
+    uint32_t counters[COUNTERS][256];
+    while(size > 0){
+        size_t piece = std::min(size,PIECE_SIZE);
+        memset(counters,0,sizeof(counters));
+        count_piece(data,data + piece,counters);
+        for(unsigned character = 0;character < 256;++character){
+            for(unsigned counter = 0;counter < COUNTERS;++counter){
+                frequencies[character] += counters[counter][character];
+            }
+        }
+        data += piece;
+        size -= piece;
+    }
+}
+
+histogram::histogram(){
+    counts.fill(0);
+}
+
+void histogram::add(const unsigned char* data,size_t size){
+    count_characters(data,size,counts);
+}
+
+void histogram::add(const unsigned char* data,size_t size,thread_pool& pool){
+    size_t parts = std::min<size_t>(pool.size(),size / MIN_THREAD_SIZE);
+    if(parts <= 1){
+        add(data,size);
+        return;
+    }
+    //Count each part of the buffer separately, and add up the counts once every thread is done.
+    std::vector<frequency_table> part_counts(parts);
+    size_t part_size = size / parts;
+    for(size_t part = 0;part < parts;++part){
+        part_counts[part].fill(0);
+        size_t begin = part * part_size;
+        size_t length = part + 1 == parts ? size - begin : part_size;
+        frequency_table& part_frequencies = part_counts[part];
+        pool.submit([data,begin,length,&part_frequencies](){
+            count_characters(data + begin,length,part_frequencies);
+        });
+    }
+    pool.wait();
+    for(auto& part_frequencies:part_counts){
+        for(unsigned character = 0;character < 256;++character){
+            counts[character] += part_frequencies[character];
+        }
+    }
+}
+
+const frequency_table& histogram::frequencies() const{
+    return counts;
+}
+
+size_t histogram::total() const{
+    size_t sum = 0;
+    for(size_t count:counts){
+        sum += count;
+    }
+    return sum;
+}
+
+double histogram::entropy_bits() const{
+    double sum = total();
+    double bits = 0;
+    for(size_t count:counts){
+        if(count != 0)
+            bits += count * std::log2(sum / count);
+    }
+    return bits;
+}
+
+bool histogram::worth_encoding(double encoded_size) const{
+    return encoded_size <= total() * (1 - MIN_ENCODING_GAIN);
+}
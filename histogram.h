@@ -0,0 +1,40 @@
+/*
+This file defines the class that counts the frequency of each character, which is the first step of compressing a file
+or a block.  It counts raw buffers of bytes rather than going through a stream a character at a time, and can split a
+large buffer between the threads of a pool.
+*/
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+#include <cstddef>
+#include "type_defs.h"
+#include "thread_pool.h"
+
+//The share of its size that encoding has to save for data to be encoded rather than stored as it is.  Data that is
+//already compressed or encrypted saves nothing, and below this, the time spent decoding it is not worth the space.
+const double MIN_ENCODING_GAIN = 1.0 / 32;
+
+class histogram{
+public:
+    //Constructs a histogram in which every count is zero.
+    histogram();
+    //Adds the characters of the buffer to the counts.
+    void add(const unsigned char* data,size_t size);
+    //Adds the characters of the buffer to the counts, splitting it between the threads of the pool if it is large.
+    void add(const unsigned char* data,size_t size,thread_pool& pool);
+    //The number of times that each character was added.  It can be passed to create_code_lengths.
+    const frequency_table& frequencies() const;
+    //The number of characters that were added.
+    size_t total() const;
+    //The entropy of the characters times their number: the number of bits that an ideal code would encode them in,
+    //which no Huffman code can beat.
+    double entropy_bits() const;
+    //Returns whether encoding the characters in encoded_size bytes, including any table, saves at least
+    //MIN_ENCODING_GAIN of their number.  Passing entropy_bits() / 8 tells, before building an encoding, whether the
+    //best one could.
+    bool worth_encoding(double encoded_size) const;
+
+private:
+    frequency_table counts;
+};
+
+#endif // HISTOGRAM_H_
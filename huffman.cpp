@@ -0,0 +1,213 @@
+#include "huffman.h"
+#include <algorithm>
+#include <cstring>
+#include "encoding_table.h"
+#include "histogram.h"
+#include "ibitstream.h"
+#include "obitstream.h"
+
+//Returns the number of bytes that write_number uses for the number.
+static size_t number_size(uint64_t number){
+    size_t bytes = 1;
+    while(number >= 0x80){
+        number >>= 7;
+        ++bytes;
+    }
+    return bytes;
+}
+
+//Reads the header of compressed data, and sets stored to whether the data is stored rather than encoded.  Returns a
+//pointer to the bitstream or the stored bytes, or nullptr if the header is invalid.  The lengths are only read for
+//encoded data.
+static const unsigned char* read_header(const unsigned char* source,size_t size,code_lengths& lengths,
+        uint64_t& decompressed_size,bool& stored){
+    const unsigned char* end = source + size;
+    if(size < HUFFMAN_MAGIC_LENGTH)
+        return nullptr;
+    stored = memcmp(source,HUFFMAN_STORED_MAGIC_NUMBER,HUFFMAN_MAGIC_LENGTH) == 0;
+    if(stored)
+        return read_number(source + HUFFMAN_MAGIC_LENGTH,end,decompressed_size);
+    if(memcmp(source,HUFFMAN_MAGIC_NUMBER,HUFFMAN_MAGIC_LENGTH) != 0)
+        return nullptr;
+    const unsigned char* data = read_lengths(source + HUFFMAN_MAGIC_LENGTH,end,lengths);
+    if(!data)
+        return nullptr;
+    return read_number(data,end,decompressed_size);
+}
+
+size_t huffman_compress_bound(size_t size,unsigned max_code_length){
+    if(!code_builder::valid_max_length(max_code_length))
+        return 0;
+    //Encoded data is never larger than the stored data, since it would be stored otherwise.
+    return HUFFMAN_MAGIC_LENGTH + number_size(size) + size;
+}
+
+bool huffman_decompressed_size(const unsigned char* source,size_t size,uint64_t& decompressed_size){
+    code_lengths lengths;
+    bool stored;
+    return read_header(source,size,lengths,decompressed_size,stored) != nullptr;
+}
+
+huffman_compressor::huffman_compressor(unsigned max_code_length)
+    :max_code_length(max_code_length),
+    stats(nullptr)
+    {}
+
+bool huffman_compressor::valid() const{
+    return code_builder::valid_max_length(max_code_length);
+}
+
+size_t huffman_compressor::bound(size_t size) const{
+    return huffman_compress_bound(size,max_code_length);
+}
+
+void huffman_compressor::append(const unsigned char* source,size_t size,std::vector<unsigned char>& destination){
+    if(stats)
+        stats->start(COUNT_PHASE);
+    histogram frequencies;
+    frequencies.add(source,size);
+    if(stats){
+        stats->stop(COUNT_PHASE,size);
+        stats->start(BUILD_PHASE);
+    }
+    size_t start = destination.size();
+    //The encoding is only built if the entropy says that one could save enough, and only used if it does save enough
+    //along with its header, which is written as it is built.
+    bool encode = frequencies.worth_encoding(frequencies.entropy_bits() / 8);
+    code_lengths lengths;
+    if(encode){
+        limit_cost cost = {0,0};
+        builder.build(frequencies.frequencies(),max_code_length,lengths,&cost);
+        destination.insert(destination.end(),HUFFMAN_MAGIC_NUMBER,HUFFMAN_MAGIC_NUMBER + HUFFMAN_MAGIC_LENGTH);
+        write_lengths(destination,lengths);
+        write_number(destination,size);
+        encode = frequencies.worth_encoding(destination.size() - start + (cost.limited_bits + 7) / 8);
+        if(!encode)
+            destination.resize(start);
+    }
+    if(stats)
+        stats->stop(BUILD_PHASE);
+    if(!encode){
+        destination.insert(destination.end(),HUFFMAN_STORED_MAGIC_NUMBER,
+            HUFFMAN_STORED_MAGIC_NUMBER + HUFFMAN_MAGIC_LENGTH);
+        write_number(destination,size);
+        if(stats){
+            stats->set_header_size(destination.size() - start);
+            stats->start(CODE_PHASE);
+        }
+        destination.insert(destination.end(),source,source + size);
+        if(stats){
+            stats->stop(CODE_PHASE,size);
+            stats->set_sizes(size,destination.size() - start);
+        }
+        return;
+    }
+    table.build(lengths);
+    if(stats){
+        stats->set_encoding(frequencies.frequencies(),lengths);
+        stats->set_header_size(destination.size() - start);
+        stats->start(CODE_PHASE);
+    }
+    obitstream bits_stream(destination);
+    bits_stream.encode(table,source,size);
+    bits_stream.flush();
+    if(stats){
+        stats->stop(CODE_PHASE,size);
+        stats->set_sizes(size,destination.size() - start);
+    }
+}
+
+void huffman_compressor::set_stats(job_stats* job){
+    stats = job;
+}
+
+size_t huffman_compressor::compress(const unsigned char* source,size_t size,unsigned char* destination){
+    //The bitstream is written a word at a time, which can go past the end of the data, so it is encoded into a
+    //buffer whose size is managed by the obitstream and then copied.
+    if(!valid())
+        return 0;
+    buffer.clear();
+    append(source,size,buffer);
+    memcpy(destination,buffer.data(),buffer.size());
+    return buffer.size();
+}
+
+bool huffman_compressor::compress(const unsigned char* source,size_t size,std::vector<unsigned char>& destination){
+    destination.clear();
+    if(!valid())
+        return false;
+    append(source,size,destination);
+    return true;
+}
+
+bool huffman_decompressor::decompress(const unsigned char* source,size_t size,unsigned char* destination,
+        size_t decompressed_size){
+    if(stats)
+        stats->start(TABLE_PHASE);
+    code_lengths lengths;
+    uint64_t total;
+    bool stored;
+    const unsigned char* data = read_header(source,size,lengths,total,stored);
+    if(!data || total != decompressed_size)
+        return false;
+    if(stored){
+        if(static_cast<uint64_t>(source + size - data) != total)
+            return false;
+        if(stats){
+            stats->stop(TABLE_PHASE,data - source);
+            stats->set_header_size(data - source);
+        }
+        //An empty destination may be a null pointer, which memcpy must not be given even to copy nothing.
+        if(total != 0)
+            memcpy(destination,data,total);
+        if(stats)
+            stats->set_sizes(size,total);
+        return true;
+    }
+    if(stats){
+        stats->stop(TABLE_PHASE,data - source);
+        stats->set_header_size(data - source);
+        stats->start(BUILD_PHASE);
+    }
+    table.build(lengths);
+    if(stats){
+        stats->stop(BUILD_PHASE);
+        stats->start(CODE_PHASE);
+    }
+    ibitstream bits_stream(data,source + size - data);
+    if(bits_stream.decode(table,destination,decompressed_size) != decompressed_size)
+        return false;
+    if(stats){
+        stats->stop(CODE_PHASE,decompressed_size);
+        stats->set_encoding(lengths,decompressed_size,source + size - data);
+        stats->set_sizes(size,decompressed_size);
+    }
+    return true;
+}
+
+void huffman_decompressor::set_stats(job_stats* job){
+    stats = job;
+}
+
+bool huffman_decompressor::decompress(const unsigned char* source,size_t size,std::vector<unsigned char>& destination){
+    code_lengths lengths;
+    uint64_t total;
+    bool stored;
+    const unsigned char* data = read_header(source,size,lengths,total,stored);
+    //Every character takes at least one bit (and a byte if it is stored), so a larger number of characters means that
+    //the header is corrupt, and the destination is not resized to it.
+    if(!data || total > static_cast<uint64_t>(source + size - data) * (stored ? 1 : 8))
+        return false;
+    destination.resize(total);
+    return decompress(source,size,destination.data(),total);
+}
+
+size_t huffman_compress(const unsigned char* source,size_t size,unsigned char* destination){
+    huffman_compressor compressor;
+    return compressor.compress(source,size,destination);
+}
+
+bool huffman_decompress(const unsigned char* source,size_t size,unsigned char* destination,size_t decompressed_size){
+    huffman_decompressor decompressor;
+    return decompressor.decompress(source,size,destination,decompressed_size);
+}
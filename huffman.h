@@ -0,0 +1,88 @@
+/*
+This file is the interface of libhuffman, which compresses and decompresses buffers in memory.  The compressed data
+has the same format as a file compressed by the program without blocks: the magic number, the table of lengths, the
+number of characters, and the bitstream, or, for data that encoding would not make smaller (see histogram.h), the
+stored magic number, the number of bytes, and the bytes as they are.  So a buffer compressed by the library can be
+written to a file and decompressed by the program, and the other way around.
+
+The huffman_compressor and huffman_decompressor classes keep their tables and buffers between calls, so a program that
+compresses many messages should keep one of each (per thread) and reuse it.  Once their buffers have grown to the
+size of the largest message, compressing and decompressing into buffers provided by the caller does not allocate
+memory.  The functions that are not members of a class construct a temporary object for each call.
+*/
+#ifndef HUFFMAN_H_
+#define HUFFMAN_H_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "code_builder.h"
+#include "decode_table.h"
+#include "encode_table.h"
+#include "job_stats.h"
+
+//The magic number at the start of compressed data.
+const char HUFFMAN_MAGIC_NUMBER[] = "huf2";
+const size_t HUFFMAN_MAGIC_LENGTH = sizeof(HUFFMAN_MAGIC_NUMBER) - 1;
+//The magic number at the start of data that is stored rather than encoded.
+const char HUFFMAN_STORED_MAGIC_NUMBER[] = "hufr";
+
+//Returns the largest number of bytes that compressing size bytes can produce, with bitstrings of at most
+//max_code_length bits.  Data is only encoded if that makes it smaller than storing it, so this is the size of the
+//stored data whatever the limit.  Returns 0 if max_code_length is not a valid limit (see
+//code_builder::valid_max_length), since nothing can be compressed with it.
+size_t huffman_compress_bound(size_t size,unsigned max_code_length = DEFAULT_MAX_CODE_LENGTH);
+//Reads the number of bytes that the compressed data decompresses to from its header.  Returns false if the data does
+//not start with a valid header.
+bool huffman_decompressed_size(const unsigned char* source,size_t size,uint64_t& decompressed_size);
+
+class huffman_compressor{
+public:
+    //max_code_length is the longest bitstring allowed, between code_builder::MIN_MAX_LENGTH and
+    //code_builder::MAX_LENGTH.  A compressor constructed with any other value is invalid, and refuses to compress.
+    explicit huffman_compressor(unsigned max_code_length = DEFAULT_MAX_CODE_LENGTH);
+    //Returns whether the limit on the length of the bitstrings that the compressor was constructed with is valid.
+    bool valid() const;
+    //Returns the largest number of bytes that compressing size bytes can produce, or 0 if the compressor is invalid.
+    size_t bound(size_t size) const;
+    //Compresses the source into the destination, which must have room for bound(size) bytes.  Returns the number of
+    //bytes written, or 0 if the compressor is invalid, since compressed data is never empty.
+    size_t compress(const unsigned char* source,size_t size,unsigned char* destination);
+    //Replaces the contents of the destination with the compressed source.  Returns false, leaving the destination
+    //empty, if the compressor is invalid.
+    bool compress(const unsigned char* source,size_t size,std::vector<unsigned char>& destination);
+    //Records the time spent in each phase of the following calls in stats, or stops recording it if stats is
+    //nullptr.  The statistics accumulate over the calls.
+    void set_stats(job_stats* stats);
+
+private:
+    //Appends the compressed source to the destination.
+    void append(const unsigned char* source,size_t size,std::vector<unsigned char>& destination);
+
+    unsigned max_code_length;
+    code_builder builder;
+    encode_table table;
+    //The buffer that compress encodes into before copying the data to the caller's buffer.
+    std::vector<unsigned char> buffer;
+    job_stats* stats;
+};
+
+class huffman_decompressor{
+public:
+    //Decompresses the source into the destination, which holds decompressed_size bytes.  Returns false if the data
+    //is corrupt or does not decompress to exactly decompressed_size bytes.
+    bool decompress(const unsigned char* source,size_t size,unsigned char* destination,size_t decompressed_size);
+    //Replaces the contents of the destination with the decompressed source.  Returns false if the data is corrupt.
+    bool decompress(const unsigned char* source,size_t size,std::vector<unsigned char>& destination);
+    //Records the time spent in each phase of the following calls in stats, as huffman_compressor::set_stats does.
+    void set_stats(job_stats* stats);
+
+private:
+    decode_table table;
+    job_stats* stats = nullptr;
+};
+
+//Compress or decompress a single buffer with a temporary object.
+size_t huffman_compress(const unsigned char* source,size_t size,unsigned char* destination);
+bool huffman_decompress(const unsigned char* source,size_t size,unsigned char* destination,size_t decompressed_size);
+
+#endif // HUFFMAN_H_
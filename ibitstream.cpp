@@ -1,63 +1,248 @@
-#include <algorithm>
 #include "ibitstream.h"
+#include "cpu_dispatch.h"
 
-using std::ifstream;
-using std::set;
-ibitstream::ibitstream(ifstream& source,const bitstring_set& valid_strings)
+ibitstream::ibitstream(std::istream& source)
     :buffer(0),
-    position(0),
-    read_from(source),
-    valid_strings(valid_strings),
-    //Find the length of the longest string.
-        max_length(std::accumulate(valid_strings.begin(),valid_strings.end(),0,
-        [](bitstring::size_type a,const bitstring& b){return std::max(a,b.size());})),
-        //bad_bit should be set if the underlying stream is invalid.
-        bad_bit(!read_from)
+    count(0),
+    first(nullptr),
+    next(nullptr),
+    end(nullptr),
+    read_from(&source),
+    chunk(CHUNK_SIZE),
+    //bad_bit should be set if the underlying stream is invalid.
+    bad_bit(!source)
     {
     fill_buffer();
 }
 
-bitstring ibitstream::extract(){
-    //Read bits from the buffer, refilling it when necessary, until a valid bitstring
-    //is read or the string was determined to be invalid.
-    bitstring retval;
-    //If the bad_bit is set then return an empty bitstring.
-    if(bad_bit)
-       return retval;
-    //Extract bits from the file until those bits form a valid bitstring or the bitstring is longer than the
-    //longest valid bitstring (which means that it is invalid).
-    while(!valid_strings.count(retval) && retval.size() <= max_length){
-        //Push the next bit into the bitstring.  Increment position after the bit is extracted.
-        retval.push_back(buffer[position++]);
-        //If the entire buffer was read then refill the buffer.
-        if(position == BUFFER_SIZE){
-            //If the end of the file was reached then activate the bad bit and an invalid sequence
-            //was encountered.
-            bad_bit = read_from.eof();
-            if(bad_bit){
-                retval.clear();
-                return retval;
-            }
-            fill_buffer();
+ibitstream::ibitstream(const unsigned char* data,size_t size)
+    :buffer(0),
+    count(0),
+    first(data),
+    next(data),
+    end(data + size),
+    read_from(nullptr),
+    chunk(),
+    bad_bit(false)
+    {
+    fill_buffer();
+}
 
-            position = 0;
+//Move one byte at a time into the buffer, reading more from the file when the chunk runs out.
+void ibitstream::fill_buffer_slow(){
+    while(count <= 56){
+        if(next == end){
+            if(!read_from || !*read_from)
+                return;
+            read_from->read(reinterpret_cast<char*>(chunk.data()),chunk.size());
+            next = chunk.data();
+            end = next + read_from->gcount();
+            if(next == end)
+                return;
         }
+        buffer |= static_cast<uint64_t>(*next++) << count;
+        count += 8;
     }
-    //If the loop was stopped because the bitstring was too long.
-    if(retval.size() > max_length){
-        bad_bit = true;
-        retval.clear();
+}
+
+ibitstream::operator bool(){
+    return !(bad_bit);
+}
+
+//The state of the stream while characters are decoded, kept in local variables so the compiler can keep it in
+//registers.
+struct extract_state{
+    uint64_t buffer;
+    unsigned count;
+    const unsigned char* next;
+};
+
+//Decodes characters whose bitstrings are found in the root table, refilling the buffer straight from memory, and
+//returns the number that were decoded.  It stops before a bitstring that needs a sub-table or is invalid, and when
+//fewer than 8 bytes are left to refill from, leaving those cases to ibitstream::decode.  It is inlined into each
+//variant below, so that each one is compiled with the instructions of its variant.
+__attribute__((always_inline))
+static inline size_t extract_characters(const decode_entry* entries,unsigned root_bits,extract_state& state,
+        const unsigned char* end,unsigned char* output,size_t size){
+    const uint64_t mask = (static_cast<uint64_t>(1) << root_bits) - 1;
+    uint64_t buffer = state.buffer;
+    unsigned count = state.count;
+    const unsigned char* next = state.next;
+    size_t decoded = 0;
+    //A refill leaves at least 56 bits in the buffer, and bitstrings in the root table are at most 11 bits long, so
+    //four characters can be decoded between refills.
+    while(size - decoded >= 4){
+        if(count < 57){
+            if(end - next < 8)
+                break;
+            uint64_t word;
+            memcpy(&word,next,sizeof(word));
+            buffer |= word << count;
+            next += (63 - count) >> 3;
+            count |= 56;
+        }
+        unsigned step = 0;
+        for(;step < 4;++step){
+            const decode_entry& entry = entries[buffer & mask];
+            if(entry.sub_bits != 0 || entry.length == 0)
+                break;
+            output[decoded + step] = entry.value;
+            buffer >>= entry.length;
+            count -= entry.length;
+        }
+        decoded += step;
+        if(step < 4)
+            break;
     }
-    return retval;
+    state.buffer = buffer;
+    state.count = count;
+    state.next = next;
+    return decoded;
 }
 
-//Read more from the file.
-void ibitstream::fill_buffer(){
-    int64_t read_to;
-    read_from.read(reinterpret_cast<char*>(&read_to),sizeof(read_to));
-    buffer = read_to;
+static size_t extract_scalar(const decode_entry* entries,unsigned root_bits,extract_state& state,
+        const unsigned char* end,unsigned char* output,size_t size){
+    return extract_characters(entries,root_bits,state,end,output,size);
 }
 
-ibitstream::operator bool(){
-    return !(bad_bit);
+#if defined(__x86_64__)
+//The variable shifts become shrx and shlx, which leave the flags alone and take the shift in any register.
+__attribute__((target("bmi2")))
+static size_t extract_bmi2(const decode_entry* entries,unsigned root_bits,extract_state& state,
+        const unsigned char* end,unsigned char* output,size_t size){
+    return extract_characters(entries,root_bits,state,end,output,size);
+}
+#endif
+
+//Decodes characters dealt in turn to INTERLEAVED_STREAMS streams, whose bitstrings are found in the root table, and
+//returns the number that were decoded, as extract_characters does for a single stream.  The state of each stream is
+//held in its own local variables, so that the stores to the output cannot alias it, and each stream is refilled
+//once for every four characters that are decoded from it.  It stops at the first character that extract_characters
+//would stop at, which leaves every stream where the characters before it end.
+__attribute__((always_inline))
+static inline size_t extract_interleaved(const decode_entry* entries,unsigned root_bits,extract_state* states,
+        const unsigned char* const* ends,unsigned char* output,size_t size){
+    const unsigned STREAMS = ibitstream::INTERLEAVED_STREAMS;
+    const uint64_t mask = (static_cast<uint64_t>(1) << root_bits) - 1;
+    uint64_t buffers[STREAMS];
+    unsigned counts[STREAMS];
+    const unsigned char* nexts[STREAMS];
+    for(unsigned stream = 0;stream < STREAMS;++stream){
+        buffers[stream] = states[stream].buffer;
+        counts[stream] = states[stream].count;
+        nexts[stream] = states[stream].next;
+    }
+    size_t decoded = 0;
+    while(size - decoded >= 4 * STREAMS){
+        bool refilled = true;
+        for(unsigned stream = 0;stream < STREAMS;++stream){
+            if(counts[stream] < 57){
+                if(ends[stream] - nexts[stream] < 8){
+                    refilled = false;
+                    break;
+                }
+                uint64_t word;
+                memcpy(&word,nexts[stream],sizeof(word));
+                buffers[stream] |= word << counts[stream];
+                nexts[stream] += (63 - counts[stream]) >> 3;
+                counts[stream] |= 56;
+            }
+        }
+        if(!refilled)
+            break;
+        //Four characters are decoded from each stream, taking one from each stream in turn.
+        unsigned step = 0;
+        for(;step < 4 * STREAMS;++step){
+            unsigned stream = step % STREAMS;
+            const decode_entry& entry = entries[buffers[stream] & mask];
+            if(entry.sub_bits != 0 || entry.length == 0)
+                break;
+            output[decoded + step] = entry.value;
+            buffers[stream] >>= entry.length;
+            counts[stream] -= entry.length;
+        }
+        decoded += step;
+        if(step < 4 * STREAMS)
+            break;
+    }
+    for(unsigned stream = 0;stream < STREAMS;++stream){
+        states[stream].buffer = buffers[stream];
+        states[stream].count = counts[stream];
+        states[stream].next = nexts[stream];
+    }
+    return decoded;
+}
+
+static size_t extract_interleaved_scalar(const decode_entry* entries,unsigned root_bits,extract_state* states,
+        const unsigned char* const* ends,unsigned char* output,size_t size){
+    return extract_interleaved(entries,root_bits,states,ends,output,size);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("bmi2")))
+static size_t extract_interleaved_bmi2(const decode_entry* entries,unsigned root_bits,extract_state* states,
+        const unsigned char* const* ends,unsigned char* output,size_t size){
+    return extract_interleaved(entries,root_bits,states,ends,output,size);
+}
+#endif
+
+size_t ibitstream::decode_interleaved(const decode_table& table,ibitstream* streams,unsigned char* output,size_t size){
+    auto extract = extract_interleaved_scalar;
+#if defined(__x86_64__)
+    if(active_variant() >= BMI2_VARIANT)
+        extract = extract_interleaved_bmi2;
+#endif
+    extract_state states[INTERLEAVED_STREAMS];
+    const unsigned char* ends[INTERLEAVED_STREAMS];
+    size_t decoded = 0;
+    while(decoded < size){
+        for(unsigned stream = 0;stream < INTERLEAVED_STREAMS;++stream){
+            states[stream] = {streams[stream].buffer,streams[stream].count,streams[stream].next};
+            ends[stream] = streams[stream].end;
+        }
+        decoded += extract(table.entries(),table.root_bits(),states,ends,output + decoded,size - decoded);
+        for(unsigned stream = 0;stream < INTERLEAVED_STREAMS;++stream){
+            streams[stream].buffer = states[stream].buffer;
+            streams[stream].count = states[stream].count;
+            streams[stream].next = states[stream].next;
+        }
+        //The next character is in a sub-table, is invalid, or is near the end of the bytes of its stream, or fewer
+        //than four characters are left in each stream.  The characters are decoded one at a time until the next one
+        //is in the first stream again.
+        do{
+            if(decoded == size)
+                return decoded;
+            int current_char = streams[decoded % INTERLEAVED_STREAMS].decode(table);
+            if(current_char < 0)
+                return decoded;
+            output[decoded++] = current_char;
+        }while(decoded % INTERLEAVED_STREAMS != 0);
+    }
+    return decoded;
+}
+
+size_t ibitstream::decode(const decode_table& table,unsigned char* output,size_t size){
+    auto extract = extract_scalar;
+#if defined(__x86_64__)
+    //Each lookup depends on the one before it, so AVX2 gathers have nothing to add to decoding a single bitstream.
+    if(active_variant() >= BMI2_VARIANT)
+        extract = extract_bmi2;
+#endif
+    size_t decoded = 0;
+    while(decoded < size){
+        extract_state state = {buffer,count,next};
+        decoded += extract(table.entries(),table.root_bits(),state,end,output + decoded,size - decoded);
+        buffer = state.buffer;
+        count = state.count;
+        next = state.next;
+        if(decoded == size)
+            break;
+        //The next character is in a sub-table, is invalid, or is near the end of the bytes in memory, or fewer than
+        //four characters are left.
+        int current_char = decode(table);
+        if(current_char < 0)
+            break;
+        output[decoded++] = current_char;
+    }
+    return decoded;
 }
@@ -1,32 +1,114 @@
 #ifndef IBITSTREAM_H_
 #define IBITSTREAM_H_
-#include <fstream>
-#include <set>
-#include <bitset>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <vector>
+#include "decode_table.h"
 #include "type_defs.h"
-//This class reads bitstrings from a file.  It keeps on reading bits from the file
-//until they form a valid bitstring, then returns the bitstring.
+//This class decodes characters from a stream of bits.  The bits are read from the file (or from a buffer in memory)
+//into a 64 bit buffer, and the next bits of the buffer are looked up in a decode_table to find the character and
+//the number of bits that it occupies.
 class ibitstream{
 public:
-    //Takes the file to read and the set of valid bitstrings.
-    ibitstream(std::ifstream&,const bitstring_set&);
-    //Will only return a bistring if it is a member of valid_strings.
-    bitstring extract();
+    //The number of streams that decode_interleaved decodes from.
+    const static unsigned INTERLEAVED_STREAMS = 4;
+
+    //Takes the file to read.
+    explicit ibitstream(std::istream&);
+    //Takes a buffer in memory to read.
+    ibitstream(const unsigned char* data,size_t size);
+    //Returns the next character, or -1 if an invalid sequence or the end of the file was reached.
+    int decode(const decode_table&);
+    //Decodes the next size characters into output.  Returns the number that were decoded, which is less than size
+    //only if an invalid sequence or the end of the file was reached.
+    size_t decode(const decode_table&,unsigned char* output,size_t size);
+    //Decodes the next size characters, which were dealt in turn to the INTERLEAVED_STREAMS streams starting with the
+    //first one, into output.  The streams do not depend on each other, so the lookups in all of them overlap.  Returns
+    //the number that were decoded, which is less than size only if one of the streams reached an invalid sequence or
+    //its end.
+    static size_t decode_interleaved(const decode_table&,ibitstream* streams,unsigned char* output,size_t size);
+    //Discards the next bits, which must be fewer than 57.
+    void skip(unsigned int bits);
+    //Returns the number of bits that were decoded or skipped since the start of the buffer.  It is only meaningful
+    //for a stream that reads from memory.
+    uint64_t position() const;
     //Determines if the end of the file or an invalid bitstring was reached.
     operator bool();
 
 private:
-    const static unsigned int BUFFER_SIZE = 64;
-    std::bitset<BUFFER_SIZE> buffer;
-    //The position within the buffer.  It starts at 0 and goes up to BUFFER_SIZE.
-    unsigned int position;
-    std::ifstream& read_from;
-    const bitstring_set& valid_strings;
-    //The length of the longest bitstring in valid_bitstrings.
-    unsigned int max_length;
+    //The number of bytes read from the file at a time.
+    const static size_t CHUNK_SIZE = 1 << 16;
+    //The bits that were read but not yet decoded.  The next bit of the stream is the least significant bit.
+    uint64_t buffer;
+    //The number of valid bits in buffer.
+    unsigned int count;
+    //The start of the buffer in memory, and the range of bytes that were not yet moved into the buffer.
+    const unsigned char* first;
+    const unsigned char* next;
+    const unsigned char* end;
+    //The file to read from, or nullptr when reading from memory.
+    std::istream* read_from;
+    std::vector<unsigned char> chunk;
     bool bad_bit;
+    //Moves bytes into the buffer until it holds at least 56 bits or the end of the file is reached.
     void fill_buffer();
+    void fill_buffer_slow();
 };
 
+inline void ibitstream::fill_buffer(){
+    if(end - next >= 8){
+        //Load 8 bytes at once and keep as many whole bytes as fit.  The bits that do not fit will be loaded
+        //again, at the same position, by the next call.
+        uint64_t word;
+        memcpy(&word,next,sizeof(word));
+        buffer |= word << count;
+        next += (63 - count) >> 3;
+        count |= 56;
+    }else{
+        fill_buffer_slow();
+    }
+}
+
+inline int ibitstream::decode(const decode_table& table){
+    if(count < 57)
+        fill_buffer();
+    const decode_entry* entries = table.entries();
+    const decode_entry* entry = &entries[buffer & ((static_cast<uint64_t>(1) << table.root_bits()) - 1)];
+    //Follow links to sub-tables for long bitstrings, consuming the bits that indexed each table.
+    while(entry->sub_bits != 0){
+        if(entry->length > count)
+            break;
+        buffer >>= entry->length;
+        count -= entry->length;
+        if(count < 57)
+            fill_buffer();
+        entry = &entries[entry->value + (buffer & ((static_cast<uint64_t>(1) << entry->sub_bits) - 1))];
+    }
+    //If the sequence is not the beginning of any bitstring, or the bitstring runs past the end of the file, then the
+    //stream is invalid.
+    if(entry->length == 0 || entry->sub_bits != 0 || entry->length > count){
+        bad_bit = true;
+        return -1;
+    }
+    buffer >>= entry->length;
+    count -= entry->length;
+    return entry->value;
+}
+
+inline void ibitstream::skip(unsigned int bits){
+    if(count < bits)
+        fill_buffer();
+    if(count < bits){
+        bad_bit = true;
+        return;
+    }
+    buffer >>= bits;
+    count -= bits;
+}
+
+inline uint64_t ibitstream::position() const{
+    return static_cast<uint64_t>(next - first) * 8 - count;
+}
 
 #endif // IBITSTREAM_H_
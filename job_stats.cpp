@@ -0,0 +1,159 @@
+#include "job_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <sys/resource.h>
+
+//The names of the phases in the JSON output, and their descriptions in the output for people.
+static const char* PHASE_NAMES[PHASE_COUNT] = {"count","build","table","code","write"};
+static const char* PHASE_DESCRIPTIONS[PHASE_COUNT] = {"counting characters","building tables","table and header",
+    "encoding or decoding","writing output"};
+
+job_stats::job_stats()
+    :current(PHASE_COUNT),
+    created(clock::now()),
+    has_encoding(false),
+    has_frequencies(false),
+    entropy(0),
+    bits_per_character(0),
+    characters(0),
+    max_length(0),
+    header_size(0),
+    input_size(0),
+    output_size(0)
+    {
+    for(unsigned phase = 0;phase < PHASE_COUNT;++phase){
+        seconds[phase] = 0;
+        bytes[phase] = 0;
+    }
+    for(auto& count:length_counts){
+        count = 0;
+    }
+}
+
+void job_stats::start(stats_phase phase){
+    started[phase] = clock::now();
+    if(phase != WRITE_PHASE)
+        current = phase;
+}
+
+void job_stats::stop(stats_phase phase,uint64_t phase_bytes){
+    double elapsed = std::chrono::duration<double>(clock::now() - started[phase]).count();
+    seconds[phase] += elapsed;
+    bytes[phase] += phase_bytes;
+    if(phase != WRITE_PHASE){
+        current = PHASE_COUNT;
+    }else if(current != PHASE_COUNT){
+        //The output was written in the middle of another phase, which should not be charged for it.
+        seconds[current] -= elapsed;
+    }
+}
+
+void job_stats::set_encoding(const frequency_table& frequencies,const code_lengths& lengths){
+    set_encoding(lengths,0,0);
+    has_frequencies = true;
+    uint64_t total = 0;
+    uint64_t bits = 0;
+    for(unsigned character = 0;character < 256;++character){
+        total += frequencies[character];
+        bits += frequencies[character] * lengths[character];
+    }
+    characters = total;
+    entropy = 0;
+    for(unsigned character = 0;character < 256;++character){
+        if(frequencies[character] != 0){
+            double probability = static_cast<double>(frequencies[character]) / total;
+            entropy -= probability * std::log2(probability);
+        }
+    }
+    bits_per_character = total ? static_cast<double>(bits) / total : 0;
+}
+
+void job_stats::set_encoding(const code_lengths& lengths,uint64_t total,uint64_t bitstream_bytes){
+    has_encoding = true;
+    max_length = 0;
+    for(auto& count:length_counts){
+        count = 0;
+    }
+    for(auto length:lengths){
+        if(length != 0 && length <= MAX_COUNTED_LENGTH){
+            ++length_counts[length];
+            max_length = std::max<unsigned>(max_length,length);
+        }
+    }
+    characters = total;
+    bits_per_character = total ? bitstream_bytes * 8.0 / total : 0;
+}
+
+void job_stats::set_header_size(uint64_t size){
+    header_size = size;
+}
+
+void job_stats::set_sizes(uint64_t input_bytes,uint64_t output_bytes){
+    input_size = input_bytes;
+    output_size = output_bytes;
+}
+
+uint64_t job_stats::peak_memory(){
+    rusage usage;
+    if(getrusage(RUSAGE_SELF,&usage) != 0)
+        return 0;
+    //Linux reports the maximum resident set size in kilobytes.
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+void job_stats::print(std::ostream& output) const{
+    double total = std::chrono::duration<double>(clock::now() - created).count();
+    output << "Total: " << total << " s, " << input_size << " bytes in, " << output_size << " bytes out";
+    if(input_size)
+        output << " (" << 100.0 * output_size / input_size << "%)";
+    output << std::endl;
+    for(unsigned phase = 0;phase < PHASE_COUNT;++phase){
+        if(seconds[phase] == 0 && bytes[phase] == 0)
+            continue;
+        output << "  " << PHASE_DESCRIPTIONS[phase] << ": " << seconds[phase] << " s, " << bytes[phase] << " bytes";
+        if(seconds[phase] > 0 && bytes[phase] > 0)
+            output << ", " << bytes[phase] / seconds[phase] / 1e6 << " MB/s";
+        output << std::endl;
+    }
+    output << "Header: " << header_size << " bytes" << std::endl;
+    if(has_encoding){
+        output << "Characters: " << characters << ", ";
+        if(has_frequencies)
+            output << "entropy " << entropy << " bits, ";
+        output << "encoded in " << bits_per_character << " bits per character" << std::endl;
+        output << "Bitstring lengths:";
+        for(unsigned length = 1;length <= max_length;++length){
+            if(length_counts[length])
+                output << " " << length << ":" << length_counts[length];
+        }
+        output << std::endl;
+    }
+    output << "Peak memory: " << peak_memory() << " bytes" << std::endl;
+}
+
+void job_stats::print_json(std::ostream& output) const{
+    double total = std::chrono::duration<double>(clock::now() - created).count();
+    output << "{\"seconds\": " << total << ", \"input_bytes\": " << input_size << ", \"output_bytes\": "
+        << output_size << ", \"header_bytes\": " << header_size << ", \"peak_memory_bytes\": " << peak_memory()
+        << ", \"phases\": {";
+    for(unsigned phase = 0;phase < PHASE_COUNT;++phase){
+        output << (phase ? ", " : "") << "\"" << PHASE_NAMES[phase] << "\": {\"seconds\": " << seconds[phase]
+            << ", \"bytes\": " << bytes[phase] << "}";
+    }
+    output << "}";
+    if(has_encoding){
+        output << ", \"characters\": " << characters;
+        if(has_frequencies)
+            output << ", \"entropy\": " << entropy;
+        output << ", \"bits_per_character\": " << bits_per_character << ", \"length_counts\": {";
+        bool first = true;
+        for(unsigned length = 1;length <= max_length;++length){
+            if(length_counts[length]){
+                output << (first ? "" : ", ") << "\"" << length << "\": " << length_counts[length];
+                first = false;
+            }
+        }
+        output << "}";
+    }
+    output << "}" << std::endl;
+}
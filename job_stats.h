@@ -0,0 +1,78 @@
+/*
+This file defines the class that collects the statistics that --stats reports: the time spent in each phase of
+compressing or decompressing a file and the number of bytes it handled, the entropy of the characters compared to the
+number of bits per character that the encoding achieved, the number of characters with each length of bitstring, the
+size of the header, and the peak memory use of the process.  The functions that take part in a job take a pointer to a
+job_stats, which is nullptr when the statistics are not wanted, so the only cost of the option when it is off is a
+comparison at the start and end of each phase.
+*/
+#ifndef JOB_STATS_H_
+#define JOB_STATS_H_
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include "type_defs.h"
+
+enum stats_phase{
+    //Counting the characters.
+    COUNT_PHASE,
+    //Computing the lengths of the bitstrings and building the tables that encode or decode them.
+    BUILD_PHASE,
+    //Writing or reading the table of lengths and the rest of the header.
+    TABLE_PHASE,
+    //Encoding or decoding the characters.
+    CODE_PHASE,
+    //Writing the output to the file.
+    WRITE_PHASE,
+    PHASE_COUNT
+};
+
+class job_stats{
+public:
+    job_stats();
+    //Starts timing the phase.  Phases may not be nested, with the exception of WRITE_PHASE, whose time is subtracted
+    //from the phase that it interrupts.
+    void start(stats_phase);
+    //Stops timing the phase, and adds the number of bytes that it handled.
+    void stop(stats_phase,uint64_t bytes = 0);
+    //Records the frequencies of the characters and the lengths of their bitstrings, from which the entropy and the
+    //number of bits per character are computed.
+    void set_encoding(const frequency_table&,const code_lengths&);
+    //Records the lengths of the bitstrings and the number of characters when the frequencies are not known, as when
+    //decompressing.  The number of bits per character is computed from the size of the bitstream.
+    void set_encoding(const code_lengths&,uint64_t characters,uint64_t bitstream_bytes);
+    //Records the size of the header, from the magic number to the start of the bitstream.
+    void set_header_size(uint64_t bytes);
+    //Records the size of the input and output of the whole job.
+    void set_sizes(uint64_t input_bytes,uint64_t output_bytes);
+    //Writes the statistics in a form meant for people, or as a JSON object.
+    void print(std::ostream&) const;
+    void print_json(std::ostream&) const;
+    //Returns the largest amount of memory that the process has used so far, in bytes.
+    static uint64_t peak_memory();
+
+private:
+    typedef std::chrono::steady_clock clock;
+    double seconds[PHASE_COUNT];
+    uint64_t bytes[PHASE_COUNT];
+    clock::time_point started[PHASE_COUNT];
+    //The phase being timed, other than WRITE_PHASE, or PHASE_COUNT if there is none.
+    stats_phase current;
+    clock::time_point created;
+    //Whether the encoding was recorded, and whether its frequencies were.
+    bool has_encoding;
+    bool has_frequencies;
+    double entropy;
+    double bits_per_character;
+    uint64_t characters;
+    //The longest bitstring whose characters are counted.  Longer lengths can only come from a corrupt table.
+    static const unsigned MAX_COUNTED_LENGTH = 64;
+    //The number of characters whose bitstring has each length.
+    uint64_t length_counts[MAX_COUNTED_LENGTH + 1];
+    unsigned max_length;
+    uint64_t header_size;
+    uint64_t input_size;
+    uint64_t output_size;
+};
+
+#endif // JOB_STATS_H_
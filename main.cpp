@@ -3,36 +3,75 @@
  the command line arguments.  If the user choose to compress a file it will perform the following steps:
 1) Opens the input file as a text file
 2) Count the occurences of each character,
-3) uses the create_encoding function to generate the encoding
+3) uses the create_code_lengths function to determine the length of each character's bitstring, and
+canonical_encoding to generate the canonical encoding with those lengths
 4) Opens the output file as a binary file
-5) Uses the write_table function to write the encoding table to form the header of the output file
+5) Uses the write_lengths function to write the lengths, followed by the number of characters in the file, to form the
+header of the output file
 6) Goes back to the beginning of the input file, reads each character, and write the encoding of the character to the
 output file (using the obitstream class).
 
 If the user choose to decompress a file, it performs the following steps:
 1) Opens the input file as a binary file
-2) Uses the read_table function to read the encoding table from the file
+2) Uses the read_lengths function to read the lengths of the bitstrings from the file, and builds a decode_table
+for the canonical encoding with those lengths
 3) Opens the output file as a text file
-4) Uses the ibitstream class to read each valid sequence of bits from the input file, writing the decoding of those
-bits to the output file
-5) Stops when the ibitstream encounters an invalid sequence or reaches the end of the file.
+4) Uses the ibitstream class to decode each valid sequence of bits from the input file (looking it up in the
+decode_table), writing the decoded character to the output file
+5) Stops when the number of characters in the header were decoded, or when the ibitstream encounters an invalid
+sequence or reaches the end of the file.
+
+With the -b option, the file is compressed in blocks instead, by the compress_blocks function (see block_codec.h), which
+compresses the blocks on several threads.  Files that were compressed in blocks are decompressed by decompress_blocks.
+Regular input files are mapped into memory (see mapped_file.h), and compressed or decompressed by working on pointers
+into the mapping; other files are read through a stream.  A file name of - reads from the standard input or writes to
+the standard output; streams are always compressed in blocks, since they cannot be read twice.  With -x, a block_reader
+uses the directory (and the index, if the file has one) to decompress only the blocks that hold the requested range.
+With --streams, the characters of each block are dealt to several bitstreams, which are decoded side by side.  Each
+block holds a checksum of its data (and, with --crc-payload, of its compressed payload), which is verified when the
+block is decoded.  With -t, a file or an archive is decompressed without writing the output, to check that it is intact.
+
+Files compressed by older versions of the program start with a different magic number, and are decompressed by
+decompress_legacy_file, which reads the full encoding table with read_table and stops at the escaped EOF character.
+
+Files that are a single bitstream, in either format, are decoded on several threads when they are mapped and -j asks
+for more than one, by splitting the bitstream at arbitrary bits and relying on the code to synchronize itself (see
+parallel_decode.h).
 
 */
 #include <iostream>
 #include <utility>
 #include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
 #include <fstream>
 #include <set>
 #include <string>
 #include <iterator>
 #include <algorithm>
 #include <functional>
+#include <memory>
 #include <numeric>
+#include <unistd.h>
 #include "type_defs.h"
 #include "create_encoding.h"
 #include "obitstream.h"
 #include "ibitstream.h"
+#include "decode_table.h"
 #include "encoding_table.h"
+#include "histogram.h"
+#include "job_stats.h"
+#include "mapped_file.h"
+#include "parallel_decode.h"
+#include "pipelined_stream.h"
+#include "static_table.h"
+#include "archive.h"
+#include "block_codec.h"
+#include "block_format.h"
+#include "block_reader.h"
+#include "cpu_dispatch.h"
+#include "thread_pool.h"
 using std::cout;
 using std::cerr;
 using std::ifstream;
@@ -47,102 +86,896 @@ using std::pair;
 using std::istreambuf_iterator;
 using std::string;
 
-const char MAGIC_NUMBER[] = "huff";
+const char MAGIC_NUMBER[] = "huf2";
+//The magic number of files that store the full encoding table and mark the end of the file with an EOF character.
+const char LEGACY_MAGIC_NUMBER[] = "huff";
+//The magic number of files that hold the input as it is, after its size, because encoding would not make it smaller.
+const char STORED_MAGIC_NUMBER[] = "hufr";
 const size_t MG_LEN = sizeof(MAGIC_NUMBER) - 1;
-void compress_file(ifstream& input_file,ofstream& output_file);
-bool decompress_file(ifstream& input_file,ofstream& output_file);
+//Both compress functions return the size of the bitstream with and without the limit on the length of the bitstrings.
+//The compress and decompress functions record the time spent in each phase in stats, unless it is nullptr.
+//With pipelined, compress_file reads each pass over the input on a separate thread (see pipelined_stream.h).  If
+//the input cannot be read, compress_file stops and leaves the input file bad.
+limit_cost compress_file(ifstream& input_file,std::ostream& output_file,unsigned threads,unsigned max_length,
+    bool pipelined,job_stats* stats);
+limit_cost compress_buffer(const unsigned char* data,size_t size,std::ostream& output_file,unsigned threads,
+    unsigned max_length,job_stats* stats);
+bool decompress_file(std::istream& input_file,std::ostream& output_file,job_stats* stats);
+//decompress_buffer decodes the bitstream on the given number of threads.
+bool decompress_buffer(const unsigned char* data,size_t size,std::ostream& output_file,unsigned threads,
+    job_stats* stats);
+//Copies the input of a file that was stored rather than encoded to the output.
+bool decompress_stored(std::istream& input_file,std::ostream& output_file,job_stats* stats);
+bool decompress_legacy_file(std::istream& input_file,std::ostream& output_file);
+//Decompresses a legacy file that is mapped to the buffer, on the given number of threads.  The table is read from
+//the file, which has to be at the start of the table, and the bitstream that follows it is decoded from the buffer.
+bool decompress_legacy_buffer(std::istream& input_file,const unsigned char* data,size_t size,
+    std::ostream& output_file,unsigned threads);
+//Compress and decompress a file with a static table.  The input of compress_static is already in memory.
+void compress_static(const unsigned char* data,size_t size,std::ostream& output_file,const static_table& table,
+    job_stats* stats);
+bool decompress_static(std::istream& input_file,std::ostream& output_file,const static_table& table,job_stats* stats);
+//Creates an archive, lists its members or extracts one of them, depending on the mode, and returns the exit status.
+int archive_main(char mode,const std::vector<const char*>& file_names,const block_options& options);
+//Appends the input file to the file of blocks, or compresses it into a new one if there is no such file, and returns
+//the exit status.
+int append_main(const std::vector<const char*>& file_names,const block_options& options);
+//Decompresses every member of the archive in the buffer to the output.  Returns false if the archive is corrupt.
+bool test_archive(const unsigned char* data,size_t size,std::ostream& output_file,unsigned threads);
+//Adds the characters of the file to the histogram.  Returns false if the file cannot be read.
+bool count_file(const char* file_name,histogram& frequencies);
+//Parses a positive number from a command line argument.  Returns false if it is not a number in the range.
+bool parse_number(const char* argument,unsigned long minimum,unsigned long maximum,unsigned long& number){
+    char* end;
+    number = strtoul(argument,&end,10);
+    return *argument != '\0' && *end == '\0' && number >= minimum && number <= maximum;
+}
+
+//A stream buffer that discards everything that is written to it, which is the output of -t.
+class null_buffer:public std::streambuf{
+protected:
+    int overflow(int character) override{
+        return traits_type::not_eof(character);
+    }
+    std::streamsize xsputn(const char*,std::streamsize count) override{
+        return count;
+    }
+};
+
 int main(int argc,char* argv[]){
-    //The program expects 3 arguments (besides for the name of the program): -c or -d for compress or decompress,
-    //the name of the input file, and the name of the output file.
-    if(argc < 4 || (strcmp(argv[1],"-c") != 0 && strcmp(argv[1],"-d") != 0)){
-        std::cerr << "Expected usage: ./huffman -c | -d input_file output_file" << endl;
+    //The program expects -c or -d for compress or decompress (or -x followed by an offset and a length to decompress
+    //part of a file), the name of the input file, and the name of the output file.  The options may come before or
+    //between them.  -t takes only the input file, which is decompressed without writing the output, and -a appends
+    //the input file to the compressed file.
+    char mode = '\0';
+    //The range to decompress with -x.
+    unsigned long extract_offset = 0;
+    unsigned long extract_length = 0;
+    //Whether to compress the file in blocks, as opposed to one stream.
+    bool blocks = false;
+    block_options options = {DEFAULT_BLOCK_SIZE,thread_pool::default_threads(),true,0,DEFAULT_MAX_CODE_LENGTH,1,
+        DATA_CRC_FLAG};
+    //Whether to report how much the limit on the length of the bitstrings costs.
+    bool report_cost = false;
+    //Whether to read and write the files on their own threads.
+    bool pipelined = false;
+    //The file holding the static table to compress or decompress with, if any.
+    const char* table_name = nullptr;
+    //Whether to report statistics about the job, and whether to report them as JSON.
+    bool report_stats = false;
+    bool stats_json = false;
+    std::vector<const char*> file_names;
+    bool valid = true;
+    for(int arg = 1;arg < argc && valid;++arg){
+        unsigned long number;
+        if(strcmp(argv[arg],"-c") == 0 || strcmp(argv[arg],"-d") == 0 || strcmp(argv[arg],"-t") == 0){
+            mode = argv[arg][1];
+        }else if(strcmp(argv[arg],"-a") == 0){
+            //'a' already stands for --archive.
+            mode = 'u';
+        }else if(strcmp(argv[arg],"--pipeline") == 0){
+            pipelined = true;
+        }else if(strcmp(argv[arg],"--archive") == 0){
+            mode = 'a';
+        }else if(strcmp(argv[arg],"--list") == 0){
+            mode = 'l';
+        }else if(strcmp(argv[arg],"--extract") == 0){
+            mode = 'e';
+        }else if(strcmp(argv[arg],"--train") == 0){
+            mode = 'r';
+        }else if(strcmp(argv[arg],"--table") == 0 && arg + 1 < argc){
+            table_name = argv[++arg];
+        }else if(strcmp(argv[arg],"-x") == 0 && arg + 2 < argc){
+            mode = 'x';
+            valid = parse_number(argv[arg + 1],0,-1,extract_offset) && parse_number(argv[arg + 2],0,-1,extract_length);
+            arg += 2;
+        }else if(strcmp(argv[arg],"-b") == 0){
+            blocks = true;
+        }else if(strcmp(argv[arg],"--block-size") == 0 && arg + 1 < argc){
+            valid = parse_number(argv[++arg],1,1 << 30,number);
+            options.block_size = number;
+            blocks = true;
+        }else if(strcmp(argv[arg],"-j") == 0 && arg + 1 < argc){
+            valid = parse_number(argv[++arg],1,1024,number);
+            options.threads = number;
+        }else if(strcmp(argv[arg],"--max-code-len") == 0 && arg + 1 < argc){
+            //Every character needs a bitstring, and there can be 256 of them.
+            valid = parse_number(argv[++arg],code_builder::MIN_MAX_LENGTH,code_builder::MAX_LENGTH,number);
+            options.max_code_length = number;
+            report_cost = true;
+        }else if(strcmp(argv[arg],"--index") == 0 && arg + 1 < argc){
+            valid = parse_number(argv[++arg],1,UINT32_MAX,number);
+            options.index_interval = number;
+            blocks = true;
+        }else if(strcmp(argv[arg],"--stats") == 0 || strcmp(argv[arg],"--stats-json") == 0){
+            report_stats = true;
+            stats_json = argv[arg][7] != '\0';
+        }else if(strcmp(argv[arg],"--cpu") == 0 && arg + 1 < argc){
+            cpu_variant variant;
+            valid = parse_variant(argv[++arg],variant);
+            if(valid && !force_variant(variant)){
+                cerr << "This processor does not support the " << argv[arg] << " variant." << endl;
+                return 1;
+            }
+        }else if(strcmp(argv[arg],"--crc-payload") == 0){
+            options.checksums |= PAYLOAD_CRC_FLAG;
+        }else if(strcmp(argv[arg],"--no-crc") == 0){
+            options.checksums = 0;
+        }else if(strcmp(argv[arg],"--streams") == 0 && arg + 1 < argc){
+            valid = parse_number(argv[++arg],1,MAX_STREAMS,number);
+            options.streams = number;
+            blocks = true;
+        }else{
+            file_names.push_back(argv[arg]);
+        }
+    }
+    //Training reads any number of sample files, and writes the table to the last file.  Creating an archive takes the
+    //archive followed by any number of files and directories, listing takes the archive, and extracting takes the
+    //archive, the member and the output file.
+    size_t expected_files = mode == 'l' || mode == 't' ? 1 : mode == 'e' ? 3 : 2;
+    bool any_number = mode == 'r' || mode == 'a';
+    if(!valid || mode == '\0' ||
+            (any_number ? file_names.size() < expected_files : file_names.size() != expected_files)){
+        std::cerr << "Expected usage: ./huffman -c | -d | -x offset length [-b] [--block-size bytes] "
+            "[--index interval] [--streams count] [--max-code-len bits] [--crc-payload | --no-crc] [-j threads] "
+            "[--pipeline] [--stats | --stats-json] [--table table_file] [--cpu scalar | bmi2 | avx2] input_file "
+            "output_file" << endl
+            << "or: ./huffman -t [-j threads] [--table table_file] input_file" << endl
+            << "or: ./huffman -a [--index interval] [--streams count] [--max-code-len bits] [-j threads] input_file "
+            "compressed_file" << endl
+            << "or: ./huffman --train [--max-code-len bits] sample_file... table_file" << endl
+            << "or: ./huffman --archive [--block-size bytes] [--crc-payload | --no-crc] [-j threads] archive_file "
+            "input_path..." << endl
+            << "or: ./huffman --list archive_file" << endl
+            << "or: ./huffman --extract [-j threads] archive_file member output_file" << endl
+            << "A file name of - reads from the standard input or writes to the standard output." << endl;
         return 1;
     }
-    //If the user choose to compress a file.
-    if(argv[1][1] == 'c'){
-        ifstream input_file(argv[2],ios::in);   //The second argument is the name of the input file.
+    if(mode == 'r'){
+        histogram frequencies;
+        for(size_t sample = 0;sample + 1 < file_names.size();++sample){
+            if(!count_file(file_names[sample],frequencies)){
+                cerr << "Cannot read file " << file_names[sample] << endl;
+                return 1;
+            }
+        }
+        static_table table = train_table(frequencies.frequencies(),
+            report_cost ? options.max_code_length : DEFAULT_TRAINED_CODE_LENGTH);
+        ofstream table_file(file_names.back(),ios::out | ios::binary);
+        write_static_table(table_file,table);
+        table_file.flush();
+        if(!table_file){
+            cerr << "Cannot write file " << file_names.back() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if(mode == 'a' || mode == 'l' || mode == 'e')
+        return archive_main(mode,file_names,options);
+    if(mode == 'u')
+        return append_main(file_names,options);
+    //A file compressed with a static table is a single stream, so it cannot be split into blocks.
+    static_table table;
+    if(table_name){
+        if(blocks || mode == 'x'){
+            cerr << "A static table cannot be used with blocks." << endl;
+            return 1;
+        }
+        ifstream table_file(table_name,ios::in | ios::binary);
+        if(!read_static_table(table_file,table)){
+            cerr << "Cannot read the table in " << table_name << endl;
+            return 1;
+        }
+    }
+    job_stats job;
+    job_stats* stats = report_stats ? &job : nullptr;
+    //A file name of - stands for the standard input or output.  Since they cannot be read twice, and the amount of
+    //input is unknown, streams are compressed in blocks, without a directory, to keep the memory use bounded.  With a
+    //static table, the input is read into memory instead.
+    bool test_only = mode == 't';
+    bool read_stdin = strcmp(file_names[0],"-") == 0;
+    bool write_stdout = !test_only && strcmp(file_names[1],"-") == 0;
+    if(read_stdin || write_stdout){
+        std::ios::sync_with_stdio(false);
+        blocks = true;
+        options.directory = false;
+    }
+    ifstream input_file;
+    if(!read_stdin){
+        input_file.open(file_names[0],ios::in | ios::binary);   //The first file is the input file.
         if(!input_file){
-            cerr << "Cannot read file " << argv[2] << endl;
+            cerr << "Cannot read file " << file_names[0] << endl;
+            return 1;
+        }
+    }
+    ofstream output_file;
+    if(!write_stdout && !test_only){
+        output_file.open(file_names[1],ios::out | ios::binary);
+        if(!output_file){
+            cerr << "Cannot write file " << file_names[1] << endl;
+            return 1;
+        }
+    }
+    //Regular input files are mapped into memory, and compressed or decompressed where they are.  Other files are
+    //read through the stream.
+    mapped_file input_map;
+    bool mapped = !read_stdin && mode != 'x' && input_map.open(file_names[0]);
+    std::istream& raw_input = read_stdin ? static_cast<std::istream&>(std::cin) : input_file;
+    null_buffer discard;
+    std::ostream null_output(&discard);
+    std::ostream& raw_output = test_only ? null_output :
+        write_stdout ? static_cast<std::ostream&>(std::cout) : output_file;
+    //With --pipeline, the input is read ahead and the output written behind by their own threads, so that waiting
+    //for them overlaps with the encoding or decoding.  The input is not wrapped when it has to be seeked: -x seeks
+    //in it, and compress_file reads it twice, wrapping each pass itself.
+    bool read_ahead = pipelined && !mapped && mode != 'x' && !(mode == 'c' && !blocks && !table_name);
+    std::unique_ptr<read_ahead_buffer> input_ahead(read_ahead ? new read_ahead_buffer(raw_input) : nullptr);
+    std::unique_ptr<write_behind_buffer> output_behind(pipelined ? new write_behind_buffer(raw_output) : nullptr);
+    std::istream pipelined_input(input_ahead.get());
+    std::ostream pipelined_output(output_behind.get());
+    std::istream& input = read_ahead ? pipelined_input : raw_input;
+    std::ostream& output = pipelined ? pipelined_output : raw_output;
+    //An error reading the input ends it as the end of the file would, so whether one happened is checked once the
+    //input was used.  The thread that reads ahead owns the raw input until it is destroyed, and reports the error
+    //itself.
+    auto input_failed = [&]{
+        return read_ahead ? input_ahead->failed() : raw_input.bad();
+    };
+
+    //If the user choose to decompress part of a file.
+    if(mode == 'x'){
+        //Finding the range requires seeking in the input file.
+        if(read_stdin){
+            cerr << "Cannot decompress part of the standard input." << endl;
+            return 1;
+        }
+        block_reader reader(input_file);
+        if(!reader.open()){
+            cerr << "Decompressing part of a file requires a file that was compressed in blocks." << endl;
+            return 1;
+        }
+        if(extract_offset > reader.size() || extract_length > reader.size() - extract_offset){
+            cerr << "The range is past the end of the file, which decompresses to " << reader.size() << " bytes."
+                << endl;
             return 1;
         }
-        ofstream output_file(argv[3],ios::out | ios::binary);
+        if(!reader.extract(extract_offset,extract_length,output)){
+            cerr << "The file is corrupt.";
+            return 2;
+        }
+    //If the user choose to compress a file.
+    }else if(mode == 'c'){
+        limit_cost cost = {0,0};
         //Write magic number to file.
-        output_file.write(MAGIC_NUMBER,MG_LEN);
-        compress_file(input_file,output_file);
-    //If the user choose to decompress a file
-    }else{
-        ifstream input_file(argv[2],ios::binary | ios::in);
-        if(!input_file){
-            cerr << "Cannot read file " << argv[2] << endl;
+        if(table_name){
+            //The whole input is needed in memory, since the number of characters comes before the bitstream.
+            std::vector<unsigned char> buffer;
+            if(!mapped)
+                buffer.assign(std::istreambuf_iterator<char>(input),std::istreambuf_iterator<char>());
+            output.write(STATIC_MAGIC_NUMBER,MG_LEN);
+            if(mapped)
+                compress_static(input_map.data(),input_map.size(),output,table,stats);
+            else
+                compress_static(buffer.data(),buffer.size(),output,table,stats);
+        }else if(blocks){
+            output.write(BLOCK_MAGIC_NUMBER,MG_LEN);
+            if(mapped)
+                cost = compress_blocks(input_map.data(),input_map.size(),output,options,stats);
+            else
+                cost = compress_blocks(input,output,options,stats);
+        }else{
+            if(mapped)
+                cost = compress_buffer(input_map.data(),input_map.size(),output,options.threads,
+                    options.max_code_length,stats);
+            else
+                cost = compress_file(input_file,output,options.threads,options.max_code_length,pipelined,stats);
+        }
+        if(report_cost){
+            uint64_t optimal_bytes = (cost.optimal_bits + 7) / 8;
+            uint64_t extra_bytes = (cost.limited_bits - cost.optimal_bits + 7) / 8;
+            cerr << "Limiting the bitstrings to " << options.max_code_length << " bits added " << extra_bytes
+                << " bytes to the " << optimal_bytes << " bytes of encoded data (" <<
+                (optimal_bytes ? 100.0 * extra_bytes / optimal_bytes : 0.0) << "%)." << endl;
+        }
+        if(input_failed()){
+            cerr << "Cannot read file " << file_names[0] << endl;
             return 1;
         }
-        ofstream output_file(argv[3],ios::out);
+    //If the user choose to decompress a file
+    }else{
         //Determine if the magic number is correct.
         char mg_buffer[MG_LEN];
-        input_file.read(mg_buffer,MG_LEN);
+        input.read(mg_buffer,MG_LEN);
+        //The rest of a mapped file follows the magic number.
+        const unsigned char* data = input_map.data();
+        size_t size = input_map.size();
+        bool decompressed;
+        if(!input){
+            decompressed = false;
+        }else if(memcmp(mg_buffer,MAGIC_NUMBER,MG_LEN) == 0){
+            decompressed = mapped ? decompress_buffer(data + MG_LEN,size - MG_LEN,output,options.threads,stats) :
+                decompress_file(input,output,stats);
+        }else if(memcmp(mg_buffer,STORED_MAGIC_NUMBER,MG_LEN) == 0){
+            decompressed = decompress_stored(input,output,stats);
+        }else if(memcmp(mg_buffer,BLOCK_MAGIC_NUMBER,MG_LEN) == 0){
+            decompressed = mapped ? decompress_blocks(data + MG_LEN,size - MG_LEN,output,options.threads,stats) :
+                decompress_blocks(input,output,options.threads,stats);
+        }else if(memcmp(mg_buffer,STATIC_MAGIC_NUMBER,MG_LEN) == 0){
+            if(!table_name){
+                cerr << "The file was compressed with a static table, which must be given with --table." << endl;
+                return 1;
+            }
+            decompressed = decompress_static(input,output,table,stats);
+        }else if(test_only && mapped && memcmp(mg_buffer,ARCHIVE_MAGIC_NUMBER,MG_LEN) == 0){
+            decompressed = test_archive(data,size,output,options.threads);
+        }else if(memcmp(mg_buffer,LEGACY_MAGIC_NUMBER,MG_LEN) == 0){
+            decompressed = mapped && options.threads > 1 ?
+                decompress_legacy_buffer(input_file,data,size,output,options.threads) :
+                decompress_legacy_file(input,output);
 	//If the magic number is incorrect.
-        if(memcmp(mg_buffer,MAGIC_NUMBER,MG_LEN) != 0){
+        }else{
             cerr << "Invalid file type. " << endl;
             return 1;
         }
-	//If the decompress_file function failed then the file is corrupt.
-        if(!decompress_file(input_file,output_file)){
+        if(input_failed()){
+            cerr << "Cannot read file " << file_names[0] << endl;
+            return 1;
+        }
+	//If the decompress function failed then the file is corrupt.
+        if(!decompressed){
             cerr << "The file is corrupt.";
             return 2;
 	}
     }
+    output.flush();
+    if(!output){
+        cerr << "Cannot write file " << file_names[1] << endl;
+        return 1;
+    }
+    if(stats){
+        //The sizes of the standard input and output are not known, and are reported as 0.
+        uint64_t input_size = 0;
+        if(mapped){
+            input_size = input_map.size();
+        }else if(!read_stdin){
+            input_file.clear();
+            input_file.seekg(0,ios::end);
+            input_size = input_file.tellg();
+        }
+        stats->set_sizes(input_size,write_stdout || test_only ? 0 : static_cast<uint64_t>(output_file.tellp()));
+        if(stats_json)
+            stats->print_json(cerr);
+        else
+            stats->print(cerr);
+    }
     return 0;
 }
 
-void compress_file(ifstream& input_file,ofstream& output_file){
-    //Count the frequency of each character in the file.
-    unordered_map<char,size_t> frequencies;
-    //For each character in the file, increment the frequency
-    for(istreambuf_iterator<char> input_file_iterator(input_file);
-            input_file_iterator != std::istreambuf_iterator<char>();++input_file_iterator){
-        frequencies[*input_file_iterator]++;
+//Builds the encoding of the characters into table, and writes the magic number, the table of lengths and the number
+//of characters.  Returns false, writing nothing, if encoding would not save MIN_ENCODING_GAIN of the characters' size
+//(see histogram.h), in which case they are stored after write_stored_header.
+bool write_encoding(std::ostream& output_file,const histogram& frequencies,unsigned max_length,limit_cost& cost,
+        encode_table& table,job_stats* stats){
+    //The entropy of the characters tells, before an encoding is built, whether the best one could save enough.
+    if(!frequencies.worth_encoding(frequencies.entropy_bits() / 8))
+        return false;
+    //The create_code_lengths function returns the length of each character's bitstring.  The canonical encoding
+    //is determined by those lengths alone, so only the lengths have to be written to the file.
+    if(stats)
+        stats->start(BUILD_PHASE);
+    limit_cost file_cost = {0,0};
+    auto lengths = create_code_lengths(frequencies.frequencies(),max_length,&file_cost);
+    std::vector<unsigned char> header;
+    write_lengths(header,lengths);
+    //Write the number of characters in the file, so that the decompressor knows where the file ends.
+    write_number(header,frequencies.total());
+    if(stats)
+        stats->stop(BUILD_PHASE);
+    if(!frequencies.worth_encoding(MG_LEN + header.size() + file_cost.limited_bits / 8.0))
+        return false;
+    cost = file_cost;
+    table.build(lengths);
+    if(stats){
+        stats->set_encoding(frequencies.frequencies(),lengths);
+        stats->start(TABLE_PHASE);
     }
-    //The create_encoding function returns an unordered_map of characters to deques of bools which represent
-    //the encoding of the characters.
-    auto encoding = create_encoding(frequencies);
-
-    //Find the least frequent character in the file, and use that as the EOF character.
-    char eof_char;
-    size_t freq = -1;   //-1 is the highest value that can be stored in an unsigned type.
-    for(auto& c_pair:frequencies){
-        if(c_pair.second < freq){
-            eof_char = c_pair.first;
-            freq = c_pair.second;
-        }
+    output_file.write(MAGIC_NUMBER,MG_LEN);
+    output_file.write(reinterpret_cast<const char*>(header.data()),header.size());
+    if(stats){
+        stats->stop(TABLE_PHASE,header.size());
+        stats->set_header_size(MG_LEN + header.size());
     }
+    return true;
+}
+//Writes the magic number of a stored file and the number of characters in it, which are written after it as they are.
+void write_stored_header(std::ostream& output_file,uint64_t total,job_stats* stats){
+    std::vector<unsigned char> header;
+    write_number(header,total);
+    output_file.write(STORED_MAGIC_NUMBER,MG_LEN);
+    output_file.write(reinterpret_cast<const char*>(header.data()),header.size());
+    if(stats)
+        stats->set_header_size(MG_LEN + header.size());
+}
 
-    //Write the encoding table to the file.
-    write_table(output_file,encoding);
+//Reads the file from its current position to the end, a piece of the given size at a time, and passes each piece
+//to the function.  With pipelined, the file is read ahead on another thread while the function works.  Returns
+//false if the file could not be read to the end, which otherwise looks like the end of the file.
+bool read_pieces(std::istream& input_file,size_t piece_size,bool pipelined,
+        const std::function<void(const unsigned char*,size_t)>& use){
+    std::unique_ptr<read_ahead_buffer> ahead(pipelined ? new read_ahead_buffer(input_file) : nullptr);
+    std::istream ahead_stream(ahead.get());
+    std::istream& source = pipelined ? ahead_stream : input_file;
+    std::vector<unsigned char> buffer(piece_size);
+    while(source){
+        source.read(reinterpret_cast<char*>(buffer.data()),buffer.size());
+        use(buffer.data(),source.gcount());
+    }
+    //The reader has passed on its last chunk, so whether it failed is known.
+    return !(pipelined ? ahead->failed() : input_file.bad());
+}
 
-    //Write the eof character to the file, between the table and the contents
-    output_file.put(eof_char);
+limit_cost compress_file(ifstream& input_file,std::ostream& output_file,unsigned threads,unsigned max_length,
+        bool pipelined,job_stats* stats){
+    //Count the frequency of each character in the file, reading it a large piece at a time so that each piece can
+    //be split between the threads.
+    histogram frequencies;
+    if(stats)
+        stats->start(COUNT_PHASE);
+    bool read;
+    {
+        thread_pool pool(threads);
+        read = read_pieces(input_file,1 << 22,pipelined,[&](const unsigned char* data,size_t size){
+            frequencies.add(data,size,pool);
+        });
+    }
+    if(stats)
+        stats->stop(COUNT_PHASE,frequencies.total());
+    limit_cost cost = {0,0};
+    if(!read){
+        input_file.setstate(ios::badbit);
+        return cost;
+    }
+    encode_table table;
+    bool encode = write_encoding(output_file,frequencies,max_length,cost,table,stats);
+    if(!encode)
+        write_stored_header(output_file,frequencies.total(),stats);
 
     obitstream output_file_stream(output_file);
+    output_file_stream.set_stats(stats);
     //Compress the file and write it to the output file.
     //Go back to the beginning of the file
     input_file.clear(); //Clear the status flags in order to clear the eof bit.
     input_file.seekg(0,ios::beg);
 
-    //Read every character from the input file and write its encoding to the output file
-    for(istreambuf_iterator<char> input_file_iter(input_file);
-            input_file_iter != istreambuf_iterator<char>();++input_file_iter){
-        char c_char = *input_file_iter;
-        //If the character is the same as is used to mark the end of the file, write it twice to escape it.
-        if(c_char == eof_char){
-            output_file_stream.insert(encoding[c_char]);
+    if(!encode){
+        if(stats)
+            stats->start(CODE_PHASE);
+        read = read_pieces(input_file,1 << 16,pipelined,[&](const unsigned char* data,size_t size){
+            output_file.write(reinterpret_cast<const char*>(data),size);
+        });
+        if(stats)
+            stats->stop(CODE_PHASE,frequencies.total());
+        if(!read)
+            input_file.setstate(ios::badbit);
+        return cost;
+    }
+    //Read the input file a large piece at a time and write the encoding of its characters to the output file.
+    if(stats)
+        stats->start(CODE_PHASE);
+    read = read_pieces(input_file,1 << 16,pipelined,[&](const unsigned char* data,size_t size){
+        output_file_stream.encode(table,data,size);
+    });
+    output_file_stream.flush();
+    if(stats)
+        stats->stop(CODE_PHASE,frequencies.total());
+    if(!read)
+        input_file.setstate(ios::badbit);
+    return cost;
+}
+
+limit_cost compress_buffer(const unsigned char* data,size_t size,std::ostream& output_file,unsigned threads,
+        unsigned max_length,job_stats* stats){
+    //Both passes work on the buffer directly.
+    histogram frequencies;
+    if(stats)
+        stats->start(COUNT_PHASE);
+    {
+        thread_pool pool(threads);
+        frequencies.add(data,size,pool);
+    }
+    if(stats)
+        stats->stop(COUNT_PHASE,size);
+    limit_cost cost = {0,0};
+    encode_table table;
+    if(!write_encoding(output_file,frequencies,max_length,cost,table,stats)){
+        write_stored_header(output_file,size,stats);
+        if(stats)
+            stats->start(CODE_PHASE);
+        output_file.write(reinterpret_cast<const char*>(data),size);
+        if(stats)
+            stats->stop(CODE_PHASE,size);
+        return cost;
+    }
+    obitstream output_file_stream(output_file);
+    output_file_stream.set_stats(stats);
+    if(stats)
+        stats->start(CODE_PHASE);
+    output_file_stream.encode(table,data,size);
+    output_file_stream.flush();
+    if(stats)
+        stats->stop(CODE_PHASE,size);
+    return cost;
+}
+
+//Decodes the given number of characters and writes them to the output file a large piece at a time.  Returns
+//false if an invalid sequence or the end of the input is reached first.  If stats is not nullptr, the decoded
+//characters are also counted, so that their entropy can be reported.
+bool decode_characters(ibitstream& input_file_stream,const decode_table& table,uint64_t total,
+        std::ostream& output_file,job_stats* stats,histogram* frequencies){
+    std::vector<unsigned char> buffer(1 << 16);
+    while(total > 0){
+        size_t count = std::min<uint64_t>(total,buffer.size());
+        if(stats)
+            stats->start(CODE_PHASE);
+        size_t decoded = input_file_stream.decode(table,buffer.data(),count);
+        if(decoded < count){
+            if(stats)
+                stats->stop(CODE_PHASE,decoded);
+            return false;
+        }
+        if(stats){
+            stats->stop(CODE_PHASE,count);
+            stats->start(COUNT_PHASE);
+            frequencies->add(buffer.data(),count);
+            stats->stop(COUNT_PHASE,count);
+            stats->start(WRITE_PHASE);
         }
-        output_file_stream.insert(encoding[c_char]);
+        output_file.write(reinterpret_cast<const char*>(buffer.data()),count);
+        if(stats)
+            stats->stop(WRITE_PHASE,count);
+        total -= count;
     }
-    //Insert the eof character to mark the end of the file.
-    output_file_stream.insert(encoding[eof_char]);
+    return true;
 }
 
-bool decompress_file(ifstream& input_file,ofstream& output_file){
+//Builds the decode_table for the lengths and decodes the bitstream that follows the header, whose size is only used
+//for the statistics.
+bool decode_bitstream(ibitstream& input_file_stream,const code_lengths& lengths,uint64_t total,
+        std::ostream& output_file,job_stats* stats,uint64_t header_size){
+    //The canonical encoding is rebuilt from the lengths directly into the lookup table.
+    if(stats)
+        stats->start(BUILD_PHASE);
+    decode_table table(lengths);
+    if(!stats)
+        return decode_characters(input_file_stream,table,total,output_file,nullptr,nullptr);
+    stats->stop(BUILD_PHASE);
+    stats->set_header_size(header_size);
+    histogram frequencies;
+    bool decoded = decode_characters(input_file_stream,table,total,output_file,stats,&frequencies);
+    stats->set_encoding(frequencies.frequencies(),lengths);
+    return decoded;
+}
+
+bool decompress_file(std::istream& input_file,std::ostream& output_file,job_stats* stats){
+    //Read the lengths of the bitstrings and the number of characters from the file.
+    if(stats)
+        stats->start(TABLE_PHASE);
+    code_lengths lengths;
+    uint64_t total;
+    if(!read_lengths(input_file,lengths) || !read_number(input_file,total))
+        return false;
+    uint64_t header_size = 0;
+    if(stats){
+        //The size of the header is found by writing it again, since the input may not be able to tell its position.
+        std::vector<unsigned char> header;
+        write_lengths(header,lengths);
+        write_number(header,total);
+        header_size = MG_LEN + header.size();
+        stats->stop(TABLE_PHASE,header.size());
+    }
+    ibitstream input_file_stream(input_file);
+    return decode_bitstream(input_file_stream,lengths,total,output_file,stats,header_size);
+}
+bool decompress_stored(std::istream& input_file,std::ostream& output_file,job_stats* stats){
+    uint64_t total;
+    if(!read_number(input_file,total))
+        return false;
+    if(stats){
+        std::vector<unsigned char> header;
+        write_number(header,total);
+        stats->set_header_size(MG_LEN + header.size());
+        stats->start(CODE_PHASE);
+    }
+    std::vector<char> buffer(1 << 16);
+    for(uint64_t remaining = total;remaining > 0;){
+        input_file.read(buffer.data(),std::min<uint64_t>(buffer.size(),remaining));
+        if(input_file.gcount() == 0)
+            return false;
+        output_file.write(buffer.data(),input_file.gcount());
+        remaining -= input_file.gcount();
+    }
+    if(stats)
+        stats->stop(CODE_PHASE,total);
+    return true;
+}
+
+//Builds the decode_table for the lengths and decodes the bitstream in the buffer on several threads.
+bool decode_buffer_parallel(const unsigned char* data,size_t size,const code_lengths& lengths,uint64_t total,
+        std::ostream& output_file,unsigned threads,job_stats* stats,uint64_t header_size){
+    if(stats)
+        stats->start(BUILD_PHASE);
+    decode_table table(lengths);
+    histogram frequencies;
+    if(stats){
+        stats->stop(BUILD_PHASE);
+        stats->set_header_size(header_size);
+        stats->start(CODE_PHASE);
+    }
+    bool decoded = decode_parallel(data,size,table,total,threads,[&](const unsigned char* characters,size_t count){
+        if(stats){
+            stats->stop(CODE_PHASE,count);
+            stats->start(COUNT_PHASE);
+            frequencies.add(characters,count);
+            stats->stop(COUNT_PHASE,count);
+            stats->start(WRITE_PHASE);
+        }
+        output_file.write(reinterpret_cast<const char*>(characters),count);
+        if(stats){
+            stats->stop(WRITE_PHASE,count);
+            stats->start(CODE_PHASE);
+        }
+        return true;
+    });
+    if(stats){
+        stats->stop(CODE_PHASE);
+        stats->set_encoding(frequencies.frequencies(),lengths);
+    }
+    return decoded;
+}
+
+bool decompress_buffer(const unsigned char* data,size_t size,std::ostream& output_file,unsigned threads,
+        job_stats* stats){
+    if(stats)
+        stats->start(TABLE_PHASE);
+    const unsigned char* start = data;
+    const unsigned char* end = data + size;
+    code_lengths lengths;
+    uint64_t total;
+    data = read_lengths(data,end,lengths);
+    if(!data || !(data = read_number(data,end,total)))
+        return false;
+    if(stats)
+        stats->stop(TABLE_PHASE,data - start);
+    if(threads > 1)
+        return decode_buffer_parallel(data,end - data,lengths,total,output_file,threads,stats,MG_LEN + (data - start));
+    ibitstream input_file_stream(data,end - data);
+    return decode_bitstream(input_file_stream,lengths,total,output_file,stats,MG_LEN + (data - start));
+}
+
+void compress_static(const unsigned char* data,size_t size,std::ostream& output_file,const static_table& table,
+        job_stats* stats){
+    //The header is the ID of the table and the number of characters.  There is no counting pass, and the table
+    //that encodes the characters is built from the lengths that were read from the table file.
+    if(stats)
+        stats->start(BUILD_PHASE);
+    encode_table encoder(table.lengths);
+    if(stats){
+        stats->stop(BUILD_PHASE);
+        stats->start(TABLE_PHASE);
+    }
+    std::vector<unsigned char> header;
+    put_u32(header,table.id);
+    write_number(header,size);
+    output_file.write(reinterpret_cast<const char*>(header.data()),header.size());
+    if(stats){
+        stats->stop(TABLE_PHASE,header.size());
+        stats->set_header_size(MG_LEN + header.size());
+        stats->start(CODE_PHASE);
+    }
+    obitstream output_file_stream(output_file);
+    output_file_stream.set_stats(stats);
+    output_file_stream.encode(encoder,data,size);
+    output_file_stream.flush();
+    if(stats){
+        stats->stop(CODE_PHASE,size);
+        stats->set_encoding(table.lengths,size,(output_file_stream.tell() + 7) / 8);
+    }
+}
+
+bool decompress_static(std::istream& input_file,std::ostream& output_file,const static_table& table,
+        job_stats* stats){
+    if(stats)
+        stats->start(TABLE_PHASE);
+    unsigned char id[4];
+    uint64_t total;
+    input_file.read(reinterpret_cast<char*>(id),sizeof(id));
+    if(!input_file || !read_number(input_file,total))
+        return false;
+    if(get_u32(id) != table.id){
+        cerr << "The file was compressed with a different table." << endl;
+        return false;
+    }
+    uint64_t header_size = 0;
+    if(stats){
+        std::vector<unsigned char> header;
+        write_number(header,total);
+        header_size = MG_LEN + sizeof(id) + header.size();
+        stats->stop(TABLE_PHASE,header_size - MG_LEN);
+    }
+    ibitstream input_file_stream(input_file);
+    return decode_bitstream(input_file_stream,table.lengths,total,output_file,stats,header_size);
+}
+
+int append_main(const std::vector<const char*>& file_names,const block_options& options){
+    //The file is read and written where its end block is, so it has to be a regular file.
+    if(strcmp(file_names[1],"-") == 0){
+        cerr << "Cannot append to the standard output." << endl;
+        return 1;
+    }
+    bool read_stdin = strcmp(file_names[0],"-") == 0;
+    ifstream input_file;
+    if(!read_stdin){
+        input_file.open(file_names[0],ios::in | ios::binary);
+        if(!input_file){
+            cerr << "Cannot read file " << file_names[0] << endl;
+            return 1;
+        }
+    }
+    mapped_file input_map;
+    bool mapped = !read_stdin && input_map.open(file_names[0]);
+    std::istream& input = read_stdin ? static_cast<std::istream&>(std::cin) : input_file;
+    std::fstream file(file_names[1],ios::in | ios::out | ios::binary);
+    if(file){
+        file.seekg(0,ios::end);
+        std::streamoff old_size = file.tellg();
+        bool appended = mapped ? append_blocks(input_map.data(),input_map.size(),file,options) :
+            append_blocks(input,file,options);
+        if(!appended){
+            //Nothing that was in the file was overwritten, so cutting off what was written restores it.
+            file.close();
+            if(old_size >= 0 && truncate(file_names[1],old_size) != 0)
+                cerr << "Cannot restore " << file_names[1] << " to its size before the append." << endl;
+            cerr << "Cannot append to " << file_names[1] << ", which has to be a file that was compressed in blocks."
+                << endl;
+            return 1;
+        }
+        return 0;
+    }
+    ofstream output_file(file_names[1],ios::out | ios::binary);
+    if(!output_file){
+        cerr << "Cannot write file " << file_names[1] << endl;
+        return 1;
+    }
+    output_file.write(BLOCK_MAGIC_NUMBER,MG_LEN);
+    if(mapped)
+        compress_blocks(input_map.data(),input_map.size(),output_file,options);
+    else
+        compress_blocks(input,output_file,options);
+    output_file.flush();
+    if(!output_file){
+        cerr << "Cannot write file " << file_names[1] << endl;
+        return 1;
+    }
+    return 0;
+}
+int archive_main(char mode,const std::vector<const char*>& file_names,const block_options& options){
+    if(mode == 'a'){
+        std::vector<std::string> files;
+        for(size_t path = 1;path < file_names.size();++path){
+            if(!collect_files(file_names[path],files)){
+                cerr << "Cannot read " << file_names[path] << endl;
+                return 1;
+            }
+        }
+        ofstream archive_file(file_names[0],ios::out | ios::binary);
+        if(!archive_file){
+            cerr << "Cannot write file " << file_names[0] << endl;
+            return 1;
+        }
+        if(!create_archive(files,archive_file,options))
+            return 1;
+        archive_file.flush();
+        if(!archive_file){
+            cerr << "Cannot write file " << file_names[0] << endl;
+            return 1;
+        }
+        return 0;
+    }
+    mapped_file archive_map;
+    uint32_t block_size;
+    unsigned char flags;
+    std::vector<archive_member> members;
+    if(!archive_map.open(file_names[0])){
+        cerr << "Cannot read file " << file_names[0] << endl;
+        return 1;
+    }
+    if(!read_archive_index(archive_map.data(),archive_map.size(),block_size,flags,members)){
+        cerr << "The archive is corrupt." << endl;
+        return 2;
+    }
+    if(mode == 'l'){
+        for(auto& member:members){
+            cout << member.size << '\t' << member.path << '\n';
+        }
+        return cout.flush() ? 0 : 1;
+    }
+    auto member = std::find_if(members.begin(),members.end(),[&](const archive_member& candidate){
+        return candidate.path == file_names[1];
+    });
+    if(member == members.end()){
+        cerr << "The archive has no member " << file_names[1] << endl;
+        return 1;
+    }
+    bool write_stdout = strcmp(file_names[2],"-") == 0;
+    ofstream output_file;
+    if(!write_stdout)
+        output_file.open(file_names[2],ios::out | ios::binary);
+    std::ostream& output = write_stdout ? static_cast<std::ostream&>(cout) : output_file;
+    if(!output){
+        cerr << "Cannot write file " << file_names[2] << endl;
+        return 1;
+    }
+    if(!extract_member(archive_map.data(),archive_map.size(),block_size,flags,*member,output,options.threads)){
+        cerr << "The file is corrupt." << endl;
+        return 2;
+    }
+    output.flush();
+    if(!output){
+        cerr << "Cannot write file " << file_names[2] << endl;
+        return 1;
+    }
+    return 0;
+}
+
+bool test_archive(const unsigned char* data,size_t size,std::ostream& output_file,unsigned threads){
+    uint32_t block_size;
+    unsigned char flags;
+    std::vector<archive_member> members;
+    if(!read_archive_index(data,size,block_size,flags,members))
+        return false;
+    for(auto& member:members){
+        if(!extract_member(data,size,block_size,flags,member,output_file,threads))
+            return false;
+    }
+    return true;
+}
+
+bool count_file(const char* file_name,histogram& frequencies){
+    mapped_file sample_map;
+    if(sample_map.open(file_name)){
+        frequencies.add(sample_map.data(),sample_map.size());
+        return true;
+    }
+    ifstream sample_file(file_name,ios::in | ios::binary);
+    std::vector<unsigned char> buffer(1 << 16);
+    while(sample_file){
+        sample_file.read(reinterpret_cast<char*>(buffer.data()),buffer.size());
+        frequencies.add(buffer.data(),sample_file.gcount());
+    }
+    return sample_file.eof();
+}
+
+bool decompress_legacy_file(std::istream& input_file,std::ostream& output_file){
 
     //Read the encoding table from the file.
     //The read_table function returns an unordered_map mapping sequences of bits to characters
@@ -150,23 +983,80 @@ bool decompress_file(ifstream& input_file,ofstream& output_file){
 
     //The eof character is the one after the table.
     char eof_char = input_file.get();
-    //The ibitstream class requires a set of valid bitstrings to know when to return the bitstring and when to
-    //extract more bits and when it encounters an invalid sequence.
-    bitstring_set valid_bitstrings;
-    //Build the valid_bitstrings set from the map by inserting the first members of the key-value pairs
-    // into the set.
-    std::transform(encoding.begin(),encoding.end(),std::inserter(valid_bitstrings,valid_bitstrings.begin()),
-        [](const map<bitstring,char>::value_type& kvp){return kvp.first;});
-    ibitstream input_file_stream(input_file,valid_bitstrings);
+    //The ibitstream class looks up the bits it reads in a decode_table, which is built from the encoding, to find
+    //the character they represent and to detect invalid sequences.
+    decode_table table(encoding);
+    ibitstream input_file_stream(input_file);
+    const size_t BUFFER_CHARACTERS = 1 << 16;
+    std::vector<char> buffer;
+    buffer.reserve(BUFFER_CHARACTERS);
     //The ibitstream class defines an implicit conversion to bool that returns true as long as there is valid
     //to read.
     while(input_file_stream){
-        char current_char = encoding[input_file_stream.extract()];
+        int current_char = input_file_stream.decode(table);
+        if(current_char < 0)
+            break;
         //If the character is the end of file character and it was not escaped then the end of the file was reached.
-        if(current_char == eof_char && (!input_file_stream || encoding[input_file_stream.extract()] != eof_char)){
-            return true;
+        //So was it if the bits end or stop being valid right after it, which decode reports as -1, a number that
+        //would otherwise be taken for an eof_char of 0xFF.
+        if(static_cast<char>(current_char) == eof_char){
+            int next_char = input_file_stream ? input_file_stream.decode(table) : -1;
+            if(next_char < 0 || static_cast<char>(next_char) != eof_char){
+                output_file.write(buffer.data(),buffer.size());
+                return true;
+            }
+        }
+        //The characters are written a large piece at a time.
+        buffer.push_back(current_char);
+        if(buffer.size() == BUFFER_CHARACTERS){
+            output_file.write(buffer.data(),buffer.size());
+            buffer.clear();
         }
-        output_file << current_char;
     }
     return false;
 }
+
+bool decompress_legacy_buffer(std::istream& input_file,const unsigned char* data,size_t size,
+        std::ostream& output_file,unsigned threads){
+    auto encoding = read_table(input_file);
+    char eof_char = input_file.get();
+    std::streamoff offset = input_file.tellg();
+    if(!input_file || offset < 0 || static_cast<uint64_t>(offset) > size)
+        return false;
+    decode_table table(encoding);
+    //Whether the last character of the previous piece was an EOF character, which the next one has to escape.
+    bool pending = false;
+    bool decoded = decode_parallel(data + offset,size - offset,table,UINT64_MAX,threads,
+            [&](const unsigned char* characters,size_t count){
+        const char* piece = reinterpret_cast<const char*>(characters);
+        size_t position = 0;
+        if(pending){
+            pending = false;
+            if(piece[0] != eof_char)
+                return false;
+            output_file.put(eof_char);
+            position = 1;
+        }
+        //Write the characters up to each EOF character, which is either escaped by the next one or ends the file.
+        while(position < count){
+            const char* found = static_cast<const char*>(memchr(piece + position,eof_char,count - position));
+            size_t next = found ? found - piece : count;
+            output_file.write(piece + position,next - position);
+            if(next == count)
+                break;
+            if(next + 1 == count){
+                pending = true;
+                break;
+            }
+            if(piece[next + 1] != eof_char)
+                return false;
+            output_file.put(eof_char);
+            position = next + 2;
+        }
+        return true;
+    });
+    //The decoding only stops before the end of the bitstream if an unescaped EOF character was found.  An EOF
+    //character that is the last character of the bitstream also ends the file, whatever character it is, as it does
+    //in decompress_legacy_file.
+    return decoded || pending;
+}
@@ -0,0 +1,56 @@
+#include "mapped_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//An empty file cannot be mapped, so its contents point here.
+static const unsigned char EMPTY_FILE[1] = {0};
+
+mapped_file::mapped_file()
+    :contents(nullptr),
+    length(0),
+    mapped(false)
+    {}
+
+mapped_file::~mapped_file(){
+    if(mapped)
+        munmap(const_cast<unsigned char*>(contents),length);
+}
+
+bool mapped_file::open(const char* name){
+    int descriptor = ::open(name,O_RDONLY);
+    if(descriptor < 0)
+        return false;
+    struct stat status;
+    if(fstat(descriptor,&status) != 0 || !S_ISREG(status.st_mode)){
+        close(descriptor);
+        return false;
+    }
+    length = status.st_size;
+    if(length == 0){
+        contents = EMPTY_FILE;
+        close(descriptor);
+        return true;
+    }
+    void* address = mmap(nullptr,length,PROT_READ,MAP_PRIVATE,descriptor,0);
+    //The mapping stays valid after the file is closed.
+    close(descriptor);
+    if(address == MAP_FAILED){
+        length = 0;
+        return false;
+    }
+    //The file is read from start to end, so the kernel can read ahead aggressively.
+    madvise(address,length,MADV_SEQUENTIAL);
+    contents = static_cast<const unsigned char*>(address);
+    mapped = true;
+    return true;
+}
+
+const unsigned char* mapped_file::data() const{
+    return contents;
+}
+
+size_t mapped_file::size() const{
+    return length;
+}
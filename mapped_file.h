@@ -0,0 +1,31 @@
+/*
+This file defines the class that maps an input file into memory, so that it can be compressed or decompressed by
+working on pointers into the mapping instead of copying it through a stream.  Only regular files can be mapped;
+pipes, terminals and other special files have to be read through a stream instead.
+*/
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+#include <cstddef>
+
+class mapped_file{
+public:
+    mapped_file();
+    //Unmaps the file.
+    ~mapped_file();
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    //Maps the file for reading.  Returns false if it is not a regular file or cannot be mapped, in which case it
+    //should be read through a stream.
+    bool open(const char* name);
+    //The contents of the file.  They are valid until the object is destroyed.
+    const unsigned char* data() const;
+    size_t size() const;
+
+private:
+    const unsigned char* contents;
+    size_t length;
+    //Whether contents points to a mapping that has to be unmapped.  It does not for an empty file.
+    bool mapped;
+};
+
+#endif // MAPPED_FILE_H_
@@ -1,41 +1,177 @@
 #include "obitstream.h"
-#include <cmath>
-obitstream::obitstream(ofstream& stream)
-    :write_to(stream),
-    buffer(),
-    position(0)
+#include <algorithm>
+#include "cpu_dispatch.h"
+
+obitstream::obitstream(ostream& stream)
+    :write_to(&stream),
+    own_bytes(BUFFER_SIZE),
+    bytes(own_bytes),
+    used(0),
+    start(0),
+    written(0),
+    accumulator(0),
+    position(0),
+    stats(nullptr)
+        {}
+
+obitstream::obitstream(std::vector<unsigned char>& destination)
+    :write_to(nullptr),
+    own_bytes(),
+    bytes(destination),
+    used(destination.size()),
+    start(destination.size()),
+    written(0),
+    accumulator(0),
+    position(0),
+    stats(nullptr)
         {}
 
-void obitstream::insert(const bitstring& to_insert){
-    //For each bit in the bitstring, write it to the buffer.  When the buffer gets
-    //full, write its contents to the file.
-    for(unsigned int bits_written = 0;bits_written < to_insert.size();++bits_written){
-        //Increment position after the bit is written.
-        buffer[position++] = to_insert[bits_written];
-        //If the buffer is full.
-        if(position == BUFFER_SIZE){
-	    auto as_long = buffer.to_ulong();
-            //Write the contents of the buffer to the file.
-            write_to.write(reinterpret_cast<char*>(&as_long),BUFFER_SIZE / 8);
-            buffer.reset();
-            position = 0;
+//The number of characters encoded between checks that the buffer has enough room.
+const size_t CHUNK_CHARACTERS = 1 << 13;
+
+//The state of the stream while a chunk is encoded, kept in local variables so the compiler can keep it in registers.
+struct pack_state{
+    unsigned char* out;
+    uint64_t bits;
+    unsigned count;
+};
+
+//Adds the bitstrings of the characters to the accumulator and stores it after each group.  It is inlined into each
+//variant below, so that each one is compiled with the instructions of its variant.
+__attribute__((always_inline))
+static inline void pack_characters(const uint64_t* entries,unsigned max_length,const unsigned char* data,
+        const unsigned char* end,pack_state& state){
+    const unsigned shift = encode_table::LENGTH_BITS;
+    const uint64_t mask = (1 << shift) - 1;
+    unsigned char* out = state.out;
+    uint64_t bits = state.bits;
+    unsigned count = state.count;
+    //Add as many bitstrings as are sure to fit in the 57 bits of the accumulator that are free after a store,
+    //then store the accumulator and keep the bits of the last incomplete byte.
+    if(max_length <= 14){
+        for(;end - data >= 4;data += 4){
+            uint64_t entry0 = entries[data[0]],entry1 = entries[data[1]];
+            uint64_t entry2 = entries[data[2]],entry3 = entries[data[3]];
+            bits |= (entry0 >> shift) << count;
+            count += entry0 & mask;
+            bits |= (entry1 >> shift) << count;
+            count += entry1 & mask;
+            bits |= (entry2 >> shift) << count;
+            count += entry2 & mask;
+            bits |= (entry3 >> shift) << count;
+            count += entry3 & mask;
+            memcpy(out,&bits,sizeof(bits));
+            out += count >> 3;
+            bits >>= count & ~7u;
+            count &= 7;
+        }
+    }else if(max_length <= 28){
+        for(;end - data >= 2;data += 2){
+            uint64_t entry0 = entries[data[0]],entry1 = entries[data[1]];
+            bits |= (entry0 >> shift) << count;
+            count += entry0 & mask;
+            bits |= (entry1 >> shift) << count;
+            count += entry1 & mask;
+            memcpy(out,&bits,sizeof(bits));
+            out += count >> 3;
+            bits >>= count & ~7u;
+            count &= 7;
         }
     }
+    for(;data != end;++data){
+        uint64_t entry = entries[*data];
+        bits |= (entry >> shift) << count;
+        count += entry & mask;
+        memcpy(out,&bits,sizeof(bits));
+        out += count >> 3;
+        bits >>= count & ~7u;
+        count &= 7;
+    }
+    state.out = out;
+    state.bits = bits;
+    state.count = count;
+}
+
+static void pack_scalar(const uint64_t* entries,unsigned max_length,const unsigned char* data,
+        const unsigned char* end,pack_state& state){
+    pack_characters(entries,max_length,data,end,state);
 }
 
-//Write the contents of the buffer to the file and reset position.
+#if defined(__x86_64__)
+//The variable shifts become shlx and shrx, which leave the flags alone and take the shift in any register.
+__attribute__((target("bmi2")))
+static void pack_bmi2(const uint64_t* entries,unsigned max_length,const unsigned char* data,
+        const unsigned char* end,pack_state& state){
+    pack_characters(entries,max_length,data,end,state);
+}
+#endif
+
+void obitstream::encode(const encode_table& table,const unsigned char* data,size_t size){
+    const uint64_t* entries = table.entries();
+    const unsigned max_length = table.max_length();
+    //Bitstrings too long to be added to an accumulator that may hold 7 bits are inserted one part at a time.
+    if(max_length > 56){
+        const unsigned shift = encode_table::LENGTH_BITS;
+        const uint64_t mask = (1 << shift) - 1;
+        for(size_t character = 0;character < size;++character){
+            insert(entries[data[character]] >> shift,entries[data[character]] & mask);
+        }
+        return;
+    }
+    auto pack = pack_scalar;
+#if defined(__x86_64__)
+    //The AVX2 variant has nothing to add to packing, which is a chain of dependent shifts.
+    if(active_variant() >= BMI2_VARIANT)
+        pack = pack_bmi2;
+#endif
+    while(size > 0){
+        size_t chunk = std::min(size,CHUNK_CHARACTERS);
+        reserve(chunk * max_length / 8 + 8);
+        pack_state state = {bytes.data() + used,accumulator,position};
+        pack(entries,max_length,data,data + chunk,state);
+        used = state.out - bytes.data();
+        accumulator = state.bits;
+        position = state.count;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+//Write the contents of the accumulator to the buffer and the buffer to the file.
 void obitstream::flush(){
-    auto as_long = buffer.to_ulong();
-    //The number of bytes written to the file should be just enough to hold the
-    // entire buffer, rounding up if necessary. This can cause the file to be
-    //padded with zeroes.
-    write_to.write(reinterpret_cast<char*>(&as_long),static_cast<int>(ceil(position / 8.0)));
+    //The number of bytes written should be just enough to hold the bits in the accumulator, rounding up if
+    //necessary.  This can cause the file to be padded with zeroes.
+    reserve(8);
+    memcpy(bytes.data() + used,&accumulator,sizeof(accumulator));
+    used += (position + 7) / 8;
+    accumulator = 0;
     position = 0;
-    buffer.reset();
+    if(write_to){
+        write_buffer();
+    }else{
+        bytes.resize(used);
+    }
+}
+
+void obitstream::write_buffer(){
+    if(stats)
+        stats->start(WRITE_PHASE);
+    write_to->write(reinterpret_cast<const char*>(bytes.data()),used);
+    if(stats)
+        stats->stop(WRITE_PHASE,used);
+    written += used;
+    used = 0;
+}
+
+void obitstream::set_stats(job_stats* job){
+    stats = job;
+}
+
+uint64_t obitstream::tell() const{
+    return (written + used - start) * 8 + position;
 }
 
 //If bits remain in the buffer, write them to the file.
 obitstream::~obitstream(){
-    if(position < BUFFER_SIZE)
-        flush();
+    flush();
 }
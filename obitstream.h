@@ -1,26 +1,85 @@
 #ifndef OBIT_STREAM_H_
 #define OBIT_STREAM_H_
-#include <bitset>
-#include <fstream>
-#include "create_encoding.h"
-//This class writes bitstrings to a file.
-using std::ofstream;
-const unsigned BUFFER_SIZE = 64;
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <vector>
+#include "encode_table.h"
+#include "job_stats.h"
+//This class writes bitstrings to a file or to a buffer in memory.  Bitstrings are shifted into a 64 bit accumulator,
+//which is stored to a large output buffer as a whole word, after which the position in the buffer advances by the
+//number of complete bytes in the accumulator.  When writing to a file, the buffer is written whenever it fills up.
+using std::ostream;
 class obitstream{
 public:
-    explicit obitstream(ofstream&);
-    //Insert a bitstring into the stream.
-    void insert(const bitstring&);
-    //Inserts the contents of the buffer into the file.
+    //Writes to the file.
+    explicit obitstream(ostream&);
+    //Appends to the buffer.  The buffer may hold extra bytes at its end until flush() is called.
+    explicit obitstream(std::vector<unsigned char>&);
+    obitstream(const obitstream&) = delete;
+    obitstream& operator=(const obitstream&) = delete;
+    //Insert a bitstring of the given length into the stream, with its first bit in the least significant position.
+    void insert(uint64_t bits,unsigned int length);
+    //Inserts the bitstring of each character of the data, looking them up in the table.
+    void encode(const encode_table&,const unsigned char* data,size_t size);
+    //Inserts the contents of the accumulator into the buffer, padding it with zeroes to a whole byte, and writes
+    //the buffer to the file.
     void flush();
+    //Returns the number of bits that were inserted into the stream.
+    uint64_t tell() const;
+    //Times the writes to the file as WRITE_PHASE of the statistics, which may be nullptr.
+    void set_stats(job_stats* stats);
     //Flushes the buffer if necessary.
     ~obitstream();
 private:
-    ofstream& write_to;
-    std::bitset<BUFFER_SIZE> buffer;
-    //The position within the buffer.  It goes up from 0 to BUFFER_SIZE.
+    //The size of the buffer used when writing to a file.
+    const static size_t BUFFER_SIZE = 1 << 17;
+    //Makes sure that the buffer has room for size more bytes, plus the word written past them.
+    void reserve(size_t size);
+    //Writes the used part of the buffer to the file and empties it.
+    void write_buffer();
+
+    //The file to write to, or nullptr when writing to memory.
+    ostream* write_to;
+    std::vector<unsigned char> own_bytes;
+    //The buffer that the bytes are stored in.  It is own_bytes when writing to a file.
+    std::vector<unsigned char>& bytes;
+    //The number of bytes of the buffer that hold data, and the number there were when the stream was created.
+    size_t used;
+    size_t start;
+    //The number of bytes written to the file so far.
+    uint64_t written;
+    //The bits that were not stored in the buffer yet, starting from the least significant one.
+    uint64_t accumulator;
+    //The number of bits in the accumulator.  It is always less than 8 between insertions.
     unsigned int position;
+    job_stats* stats;
 };
 
+inline void obitstream::reserve(size_t size){
+    if(bytes.size() - used < size + 8){
+        if(write_to && used > 0)
+            write_buffer();
+        if(bytes.size() - used < size + 8)
+            bytes.resize(std::max(used + size + 8,bytes.size() * 2));
+    }
+}
+
+inline void obitstream::insert(uint64_t bits,unsigned int length){
+    //The accumulator holds fewer than 8 bits, so up to 56 bits can be added at once.
+    if(length > 56){
+        insert(bits & 0xffffffff,32);
+        bits >>= 32;
+        length -= 32;
+    }
+    reserve(8);
+    accumulator |= bits << position;
+    position += length;
+    memcpy(bytes.data() + used,&accumulator,sizeof(accumulator));
+    used += position >> 3;
+    accumulator >>= position & ~7u;
+    position &= 7;
+}
 
 #endif // OBIT_STREAM_H_
@@ -0,0 +1,144 @@
+#include "parallel_decode.h"
+#include <algorithm>
+#include <vector>
+#include "ibitstream.h"
+#include "thread_pool.h"
+
+//The number of bits of the bitstream in each segment.
+const uint64_t SEGMENT_BITS = uint64_t(1) << 23;
+//The number of characters at the start of each segment whose positions are recorded.  Decoders usually synchronize
+//within a few dozen characters, but a code that is dominated by a few short bitstrings can take thousands.  The
+//decoder of the previous segment stops within BATCH_CHARACTERS of the segment's first bit.
+const size_t SYNC_CHARACTERS = 1 << 14;
+//The number of characters that are decoded between checks of whether the decoder passed the end of its segment.
+const size_t BATCH_CHARACTERS = 256;
+
+struct segment{
+    //The bits of the bitstream that the segment covers.  The decoder stops at the first character that starts at or
+    //after end, give or take a batch.
+    uint64_t start;
+    uint64_t end;
+    //The bit at which the decoder stopped, which is the start of a character if the decoder was synchronized.
+    uint64_t stop;
+    //False if the decoder stopped at an invalid sequence or at the end of the buffer before reaching end.
+    bool complete;
+    //The bit at which each of the first SYNC_CHARACTERS characters started.
+    std::vector<uint64_t> starts;
+    std::vector<unsigned char> characters;
+};
+
+//Decodes the segment from the bit in its start, decoding at most limit characters.
+static void decode_segment(const unsigned char* data,size_t size,const decode_table& table,uint64_t limit,
+        segment& part){
+    part.starts.clear();
+    part.characters.clear();
+    part.complete = true;
+    size_t first_byte = part.start / 8;
+    ibitstream stream(data + first_byte,size - first_byte);
+    stream.skip(part.start % 8);
+    uint64_t offset = first_byte * 8;
+    //Decode the first characters one at a time to record where they start.
+    while(part.characters.size() < limit && part.starts.size() < SYNC_CHARACTERS &&
+            offset + stream.position() < part.end){
+        part.starts.push_back(offset + stream.position());
+        int current_char = stream.decode(table);
+        if(current_char < 0){
+            part.complete = false;
+            break;
+        }
+        part.characters.push_back(current_char);
+    }
+    //Then decode the rest a batch at a time, straight into the vector, which is only resized when it is full.
+    size_t used = part.characters.size();
+    while(part.complete && used < limit && offset + stream.position() < part.end){
+        size_t batch = std::min<uint64_t>(BATCH_CHARACTERS,limit - used);
+        if(part.characters.size() - used < batch)
+            part.characters.resize(std::max(part.characters.size() * 2,used + batch));
+        size_t decoded = stream.decode(table,part.characters.data() + used,batch);
+        used += decoded;
+        part.complete = decoded == batch;
+    }
+    part.characters.resize(used);
+    part.stop = offset + stream.position();
+}
+
+//Decodes the bitstream from the bit in position, which is the start of a character, until a character starts at one
+//of the recorded starts of the segment, appending the characters before it to prefix.  Returns the index of that
+//start, or the number of starts if there is none.
+static size_t synchronize(const unsigned char* data,size_t size,const decode_table& table,uint64_t position,
+        const segment& part,std::vector<unsigned char>& prefix){
+    const std::vector<uint64_t>& starts = part.starts;
+    size_t index = std::lower_bound(starts.begin(),starts.end(),position) - starts.begin();
+    if(index == starts.size() || starts[index] == position)
+        return index;
+    size_t first_byte = position / 8;
+    ibitstream stream(data + first_byte,size - first_byte);
+    stream.skip(position % 8);
+    uint64_t offset = first_byte * 8;
+    while(true){
+        int current_char = stream.decode(table);
+        if(current_char < 0)
+            return starts.size();
+        prefix.push_back(current_char);
+        position = offset + stream.position();
+        while(index < starts.size() && starts[index] < position){
+            ++index;
+        }
+        if(index == starts.size() || starts[index] == position)
+            return index;
+    }
+}
+
+bool decode_parallel(const unsigned char* data,size_t size,const decode_table& table,uint64_t limit,unsigned threads,
+        const character_sink& output){
+    thread_pool pool(threads);
+    std::vector<segment> segments(pool.size() * 2);
+    uint64_t total_bits = static_cast<uint64_t>(size) * 8;
+    //The start of the next character of the stream, which is always the true start of a bitstring.
+    uint64_t position = 0;
+    uint64_t remaining = limit;
+    std::vector<unsigned char> prefix;
+    //Passes characters to the output until the limit is reached.  Returns false to stop the decoding.
+    auto pass = [&](const unsigned char* characters,size_t count){
+        count = std::min<uint64_t>(count,remaining);
+        remaining -= count;
+        return (count == 0 || output(characters,count)) && remaining > 0;
+    };
+    while(remaining > 0){
+        //Split the next part of the bitstream into segments and decode them, each from its first bit.
+        size_t count = 0;
+        for(uint64_t start = position;count < segments.size() && start < total_bits;start += SEGMENT_BITS){
+            segment& part = segments[count++];
+            part.start = start;
+            part.end = std::min(start + SEGMENT_BITS,total_bits);
+            pool.submit([data,size,&table,remaining,&part]{
+                decode_segment(data,size,table,remaining,part);
+            });
+        }
+        pool.wait();
+        //The end of the buffer was reached before the last character.
+        if(count == 0)
+            return false;
+        for(size_t index = 0;index < count;++index){
+            segment& part = segments[index];
+            //Follow the stream from where the previous segment stopped until it reaches the start of a character of the
+            //segment, usually at once.  If it never does, the segment's decoder did not synchronize within the
+            //recorded characters, and the segment is decoded again from there.
+            prefix.clear();
+            size_t skip = synchronize(data,size,table,position,part,prefix);
+            if(skip == part.starts.size()){
+                prefix.clear();
+                part.start = position;
+                decode_segment(data,size,table,remaining,part);
+                skip = 0;
+            }
+            if(!pass(prefix.data(),prefix.size()) ||
+                    !pass(part.characters.data() + skip,part.characters.size() - skip))
+                return true;
+            if(!part.complete)
+                return false;
+            position = part.stop;
+        }
+    }
+    return true;
+}
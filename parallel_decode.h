@@ -0,0 +1,33 @@
+/*
+This file contains the function that decodes a single bitstream on several threads, for files that were not
+compressed in blocks.  Such a bitstream has no marks of where its bitstrings start, so the bitstream is split into
+segments at arbitrary bits, and each thread decodes a segment starting at its first bit, as if a bitstring started
+there.  That guess is usually wrong, but Huffman codes synchronize themselves: a decoder that starts in the middle of a
+bitstring reads garbage for a few characters, after which it almost always reaches the end of a real bitstring and
+decodes the same characters as a decoder that started at the beginning of the stream.
+
+Each thread therefore records the bit at which each of the first characters of its segment started.  Once the
+segments are decoded, they are stitched together in order: the decoder of the previous segment stopped at the true
+start of a bitstring, and if the decoder of the segment also started a character at that bit, every character it
+decoded from there on is correct, and the ones before it are dropped.  If it did not (which needs a segment that
+never synchronized within the recorded characters), the segment is decoded again from the true bit on the stitching
+thread.  The output is therefore always the same as that of decoding the bitstream from its start.  The segments are
+decoded a batch at a time, so the memory used depends on the number of threads rather than on the size of the file.
+*/
+#ifndef PARALLEL_DECODE_H_
+#define PARALLEL_DECODE_H_
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "decode_table.h"
+
+//Receives the decoded characters, a piece at a time and in order.  It returns false to stop the decoding.
+typedef std::function<bool(const unsigned char* characters,size_t count)> character_sink;
+
+//Decodes the bitstream in the buffer with the table on the given number of threads, and passes the characters to the
+//output until limit characters were passed or the output returns false.  Returns false if an invalid sequence or the
+//end of the buffer is reached before that.
+bool decode_parallel(const unsigned char* data,size_t size,const decode_table& table,uint64_t limit,unsigned threads,
+    const character_sink& output);
+
+#endif // PARALLEL_DECODE_H_
@@ -0,0 +1,142 @@
+#include "pipelined_stream.h"
+
+//The size of each chunk, and the number of chunks, which bounds how far one thread can get ahead of the other.
+const size_t CHUNK_SIZE = 1 << 20;
+const size_t CHUNKS = 4;
+
+read_ahead_buffer::read_ahead_buffer(std::istream& source)
+    :source(source),
+    storage(CHUNK_SIZE * CHUNKS),
+    full_chunks(CHUNKS),
+    free_chunks(CHUNKS),
+    current{nullptr,0},
+    has_current(false),
+    finished(false),
+    stopping(false),
+    read_failed(false)
+    {
+    for(size_t chunk = 0;chunk < CHUNKS;++chunk){
+        free_chunks.try_push(stream_chunk{storage.data() + chunk * CHUNK_SIZE,0});
+    }
+    reader = std::thread(&read_ahead_buffer::read_chunks,this);
+}
+
+read_ahead_buffer::~read_ahead_buffer(){
+    stopping = true;
+    reader.join();
+}
+
+void read_ahead_buffer::read_chunks(){
+    stream_chunk chunk;
+    while(true){
+        backoff waiting;
+        while(!free_chunks.try_pop(chunk)){
+            if(stopping)
+                return;
+            waiting.wait();
+        }
+        source.read(chunk.data,CHUNK_SIZE);
+        chunk.size = source.gcount();
+        //A chunk that is not full is the last one, and tells the other thread that the source has ended.
+        bool last = chunk.size < CHUNK_SIZE;
+        if(last && source.bad())
+            read_failed = true;
+        //There is always room for the chunk, since there are only as many chunks as slots.
+        full_chunks.try_push(chunk);
+        if(last)
+            return;
+    }
+}
+
+read_ahead_buffer::int_type read_ahead_buffer::underflow(){
+    if(gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+    if(finished)
+        return traits_type::eof();
+    if(has_current)
+        free_chunks.try_push(current);
+    backoff waiting;
+    while(!full_chunks.try_pop(current)){
+        waiting.wait();
+    }
+    has_current = true;
+    finished = current.size < CHUNK_SIZE;
+    if(current.size == 0)
+        return traits_type::eof();
+    setg(current.data,current.data,current.data + current.size);
+    return traits_type::to_int_type(*gptr());
+}
+
+write_behind_buffer::write_behind_buffer(std::ostream& destination)
+    :destination(destination),
+    storage(CHUNK_SIZE * CHUNKS),
+    full_chunks(CHUNKS),
+    free_chunks(CHUNKS),
+    handed(0),
+    written(0),
+    stopping(false),
+    write_failed(false)
+    {
+    //One chunk is the put area, and the rest wait to be used.
+    current = stream_chunk{storage.data(),0};
+    for(size_t chunk = 1;chunk < CHUNKS;++chunk){
+        free_chunks.try_push(stream_chunk{storage.data() + chunk * CHUNK_SIZE,0});
+    }
+    setp(current.data,current.data + CHUNK_SIZE);
+    writer = std::thread(&write_behind_buffer::write_chunks,this);
+}
+
+write_behind_buffer::~write_behind_buffer(){
+    sync();
+    stopping = true;
+    writer.join();
+}
+
+void write_behind_buffer::write_chunks(){
+    stream_chunk chunk;
+    while(true){
+        backoff waiting;
+        while(!full_chunks.try_pop(chunk)){
+            if(stopping)
+                return;
+            waiting.wait();
+        }
+        destination.write(chunk.data,chunk.size);
+        if(!destination)
+            write_failed = true;
+        free_chunks.try_push(chunk);
+        ++written;
+    }
+}
+
+void write_behind_buffer::hand_off(){
+    current.size = pptr() - pbase();
+    if(current.size > 0){
+        full_chunks.try_push(current);
+        ++handed;
+        backoff waiting;
+        while(!free_chunks.try_pop(current)){
+            waiting.wait();
+        }
+    }
+    setp(current.data,current.data + CHUNK_SIZE);
+}
+
+write_behind_buffer::int_type write_behind_buffer::overflow(int_type character){
+    hand_off();
+    if(!traits_type::eq_int_type(character,traits_type::eof())){
+        *pptr() = traits_type::to_char_type(character);
+        pbump(1);
+    }
+    return traits_type::not_eof(character);
+}
+
+int write_behind_buffer::sync(){
+    hand_off();
+    backoff waiting;
+    while(written != handed){
+        waiting.wait();
+    }
+    destination.flush();
+    return write_failed || !destination ? -1 : 0;
+}
@@ -0,0 +1,93 @@
+/*
+This file defines the stream buffers that split reading and writing files off into their own threads, so that the
+time spent waiting for the disk overlaps with the time spent encoding or decoding instead of adding to it.  A
+read_ahead_buffer starts a thread that reads large chunks of a stream ahead of the thread that uses the data, and a
+write_behind_buffer starts a thread that writes the chunks that were filled by the thread producing the data.  Each
+one passes its chunks between the two threads through a pair of spsc_rings: one for the chunks that hold data, and one
+that returns the empty chunks to be reused, so the memory used is a fixed number of chunks.  Both buffers are used
+through a std::istream or std::ostream that is constructed around them, so the code that reads and writes streams
+does not have to change.
+*/
+#ifndef PIPELINED_STREAM_H_
+#define PIPELINED_STREAM_H_
+#include <atomic>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+#include "spsc_ring.h"
+
+//A piece of the data passed between the threads.
+struct stream_chunk{
+    char* data;
+    size_t size;
+};
+
+class read_ahead_buffer:public std::streambuf{
+public:
+    //Starts reading the source from its current position.  The source should not be used until the object is
+    //destroyed.
+    explicit read_ahead_buffer(std::istream& source);
+    //Stops the thread, which may not have reached the end of the source.
+    ~read_ahead_buffer();
+    read_ahead_buffer(const read_ahead_buffer&) = delete;
+    read_ahead_buffer& operator=(const read_ahead_buffer&) = delete;
+    //Returns true if the source could not be read, as opposed to ending.
+    bool failed() const {return read_failed;}
+
+protected:
+    int_type underflow();
+
+private:
+    //The loop run by the thread.
+    void read_chunks();
+    std::istream& source;
+    std::vector<char> storage;
+    spsc_ring<stream_chunk> full_chunks;
+    spsc_ring<stream_chunk> free_chunks;
+    //The chunk that the get area points into, if there is one.
+    stream_chunk current;
+    bool has_current;
+    //Whether the last chunk of the source was reached.
+    bool finished;
+    std::atomic<bool> stopping;
+    std::atomic<bool> read_failed;
+    std::thread reader;
+};
+
+class write_behind_buffer:public std::streambuf{
+public:
+    //Starts a thread that writes to the destination, which should not be used until the object is destroyed.
+    explicit write_behind_buffer(std::ostream& destination);
+    //Writes the remaining data and stops the thread.
+    ~write_behind_buffer();
+    write_behind_buffer(const write_behind_buffer&) = delete;
+    write_behind_buffer& operator=(const write_behind_buffer&) = delete;
+
+protected:
+    int_type overflow(int_type character);
+    //Waits until all of the data has been written and flushes the destination.  Returns -1 if it could not be
+    //written.
+    int sync();
+
+private:
+    //The loop run by the thread.
+    void write_chunks();
+    //Passes the data in the put area to the thread, and makes an empty chunk the put area.
+    void hand_off();
+    std::ostream& destination;
+    std::vector<char> storage;
+    spsc_ring<stream_chunk> full_chunks;
+    spsc_ring<stream_chunk> free_chunks;
+    //The chunk that the put area points into.
+    stream_chunk current;
+    //The number of chunks handed to the thread, and the number it has written.
+    size_t handed;
+    std::atomic<size_t> written;
+    std::atomic<bool> stopping;
+    std::atomic<bool> write_failed;
+    std::thread writer;
+};
+
+#endif // PIPELINED_STREAM_H_
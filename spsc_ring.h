@@ -0,0 +1,78 @@
+/*
+This file defines a bounded queue for exactly one thread that pushes items and one thread that pops them.  Since each
+index is only written by one of the threads, the queue needs no lock: the producer publishes an item by storing the
+new tail with release ordering, and the consumer sees the item once it loads that tail with acquire ordering (and the
+other way around for the slots that the consumer frees).  The queue never blocks; a thread that finds it full or
+empty waits with a backoff and tries again.
+*/
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+template<typename T>
+class spsc_ring{
+public:
+    //Constructs a queue that holds up to capacity items.
+    explicit spsc_ring(size_t capacity)
+        :slots(capacity + 1),
+        head(0),
+        tail(0)
+        {}
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+    //Adds the item to the queue, unless it is full.  Only called by the producer.
+    bool try_push(const T& item){
+        size_t current = tail.load(std::memory_order_relaxed);
+        size_t next = current + 1 == slots.size() ? 0 : current + 1;
+        if(next == head.load(std::memory_order_acquire))
+            return false;
+        slots[current] = item;
+        tail.store(next,std::memory_order_release);
+        return true;
+    }
+    //Removes the oldest item from the queue, unless it is empty.  Only called by the consumer.
+    bool try_pop(T& item){
+        size_t current = head.load(std::memory_order_relaxed);
+        if(current == tail.load(std::memory_order_acquire))
+            return false;
+        item = slots[current];
+        head.store(current + 1 == slots.size() ? 0 : current + 1,std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> slots;
+    //The slot of the oldest item, and the slot after the newest one.  They are kept a cache line apart, so that the
+    //threads do not slow each other down by writing to the same line.
+    std::atomic<size_t> head;
+    char padding[64];
+    std::atomic<size_t> tail;
+};
+
+//Waits for another thread to make progress.  The first few waits only yield the processor, which keeps the latency
+//low when the other thread is about to finish; after that the thread sleeps, so that a stage that waits for a long
+//time does not take the processor away from the stages doing the work.
+class backoff{
+public:
+    backoff()
+        :waits(0)
+        {}
+    void wait(){
+        if(waits < YIELDS){
+            ++waits;
+            std::this_thread::yield();
+        }else{
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+private:
+    const static unsigned YIELDS = 64;
+    unsigned waits;
+};
+
+#endif // SPSC_RING_H_
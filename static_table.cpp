@@ -0,0 +1,53 @@
+#include "static_table.h"
+#include <cstring>
+#include "code_builder.h"
+#include "encoding_table.h"
+
+static const size_t TABLE_MAGIC_LENGTH = sizeof(TABLE_MAGIC_NUMBER) - 1;
+
+static_table train_table(const frequency_table& sample,unsigned max_length){
+    frequency_table frequencies;
+    for(unsigned character = 0;character < 256;++character){
+        frequencies[character] = sample[character] + 1;
+    }
+    static_table table;
+    code_builder builder;
+    builder.build(frequencies,max_length,table.lengths);
+    table.id = table_id(table.lengths);
+    return table;
+}
+
+uint32_t table_id(const code_lengths& lengths){
+    //The 32 bit FNV-1a hash of the lengths.
+    uint32_t hash = 2166136261u;
+    for(auto length:lengths){
+        hash = (hash ^ length) * 16777619u;
+    }
+    return hash;
+}
+
+void write_static_table(std::ostream& destination,const static_table& table){
+    destination.write(TABLE_MAGIC_NUMBER,TABLE_MAGIC_LENGTH);
+    for(unsigned byte = 0;byte < 4;++byte){
+        destination.put(static_cast<char>(table.id >> (byte * 8)));
+    }
+    write_lengths(destination,table.lengths);
+}
+
+bool read_static_table(std::istream& source,static_table& table){
+    char magic[TABLE_MAGIC_LENGTH];
+    unsigned char id[4];
+    source.read(magic,TABLE_MAGIC_LENGTH);
+    source.read(reinterpret_cast<char*>(id),4);
+    if(!source || memcmp(magic,TABLE_MAGIC_NUMBER,TABLE_MAGIC_LENGTH) != 0 || !read_lengths(source,table.lengths))
+        return false;
+    table.id = 0;
+    for(unsigned byte = 0;byte < 4;++byte){
+        table.id |= static_cast<uint32_t>(id[byte]) << (byte * 8);
+    }
+    for(auto length:table.lengths){
+        if(length == 0)
+            return false;
+    }
+    return table.id == table_id(table.lengths);
+}
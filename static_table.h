@@ -0,0 +1,44 @@
+/*
+This file contains the functions that train, save and load a static table: an encoding that is built once from a
+sample of the data instead of from each file.  A file compressed with a static table does not count its characters or
+build an encoding, and instead of the table of lengths its header holds the table's ID, which is a hash of the
+lengths, so that decompressing it with a different table is detected.  This saves the table of lengths (and the
+counting pass) for small files, whose table can be larger than the savings from their own encoding.
+
+Every character gets a bitstring in a trained table, even those that do not occur in the sample, so any file can be
+compressed with it.  A table file holds the magic number, the ID, and the table of lengths (see write_lengths).
+*/
+#ifndef STATIC_TABLE_H_
+#define STATIC_TABLE_H_
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include "type_defs.h"
+
+//The magic number of table files.
+const char TABLE_MAGIC_NUMBER[] = "huft";
+//The magic number of files compressed with a static table.  They hold the table's ID as 4 bytes, starting from the
+//least significant one, the number of characters (see write_number), and the bitstream.
+const char STATIC_MAGIC_NUMBER[] = "hufs";
+
+//The longest bitstring in a trained table when the user does not give a limit.  It is longer than the default for
+//files, since the characters that do not occur in the sample take up less of the encoding with longer bitstrings.
+const unsigned DEFAULT_TRAINED_CODE_LENGTH = 15;
+
+struct static_table{
+    uint32_t id;
+    code_lengths lengths;
+};
+
+//Builds the table for the frequencies of the characters in the sample, with bitstrings of at most max_length bits.
+//Characters that do not occur in the sample are given a count of one, which puts them at the longest lengths.
+static_table train_table(const frequency_table& sample,unsigned max_length);
+//Returns the ID of the table with the given lengths.
+uint32_t table_id(const code_lengths&);
+//Writes the table to a file.
+void write_static_table(std::ostream& destination,const static_table&);
+//Reads a table written by write_static_table.  Returns false if the file is not a valid table, or the table does
+//not give every character a bitstring.
+bool read_static_table(std::istream& source,static_table&);
+
+#endif // STATIC_TABLE_H_
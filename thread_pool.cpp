@@ -0,0 +1,70 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+thread_pool::thread_pool(unsigned threads)
+    :pending(0),
+    stopping(false)
+    {
+    if(threads > 1){
+        for(unsigned thread = 0;thread < threads;++thread){
+            workers.push_back(std::thread(&thread_pool::work,this));
+        }
+    }
+}
+
+thread_pool::~thread_pool(){
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    task_ready.notify_all();
+    for(auto& worker:workers){
+        worker.join();
+    }
+}
+
+void thread_pool::submit(std::function<void()> task){
+    //Without any threads, the task is run right away.
+    if(workers.empty()){
+        task();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+        ++pending;
+    }
+    task_ready.notify_one();
+}
+
+void thread_pool::wait(){
+    std::unique_lock<std::mutex> lock(mutex);
+    tasks_done.wait(lock,[this]{return pending == 0;});
+}
+
+unsigned thread_pool::size() const{
+    return workers.empty() ? 1 : workers.size();
+}
+
+unsigned thread_pool::default_threads(){
+    //hardware_concurrency returns 0 if the number of cores cannot be determined.
+    return std::max(1u,std::thread::hardware_concurrency());
+}
+
+void thread_pool::work(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+        task_ready.wait(lock,[this]{return stopping || !tasks.empty();});
+        if(tasks.empty())
+            return;
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        //Run the task without holding the lock, so other threads can take tasks in the meantime.
+        lock.unlock();
+        task();
+        lock.lock();
+        if(--pending == 0)
+            tasks_done.notify_all();
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+//This class runs tasks on a fixed number of threads.  Tasks are run in the order in which they were submitted, and
+//wait() blocks until all of them are done.  A pool of one thread runs each task in submit() instead of starting a
+//thread.
+class thread_pool{
+public:
+    explicit thread_pool(unsigned threads);
+    //Waits for the remaining tasks and stops the threads.
+    ~thread_pool();
+    void submit(std::function<void()> task);
+    //Blocks until every task that was submitted is done.
+    void wait();
+    //The number of tasks that run at the same time.
+    unsigned size() const;
+    //The number of threads to use when the user does not specify it.
+    static unsigned default_threads();
+
+private:
+    //The loop run by each thread.
+    void work();
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > tasks;
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    std::condition_variable tasks_done;
+    //The number of tasks that were submitted but are not done yet.
+    size_t pending;
+    bool stopping;
+};
+
+#endif // THREAD_POOL_H_
@@ -1,14 +1,17 @@
 /*
 This file contains type definitions that are used elsewhere in the program.  It defines types to represent sequences
 of bits, maps between sequences of bits and chars, and sets of sequences of bits.  In order to create a hash table
-of deques of bits, it defines a functor to serve as a hash function for a sequence of bits.
+of deques of bits, it defines a functor to serve as a hash function for a sequence of bits.  It also defines the
+type used to represent an encoding by the length of each character's bitstring.
 */
 #ifndef TYPE_DEFS_H_
 #define TYPE_DEFS_H_
+#include <array>
 #include <functional>
 #include <deque>
 #include <unordered_map>
 #include <algorithm>
+#include <numeric>
 #include <unordered_set>
 #include <vector>
 typedef std::vector<bool> bitstring;
@@ -28,4 +31,9 @@ struct hash<bitstring>{
 }
 typedef std::unordered_map<bitstring,char>  decoding_t;
 typedef std::unordered_set<bitstring> bitstring_set;
+//The length of the bitstring of each character, indexed by the character as an unsigned char.  Characters that do
+//not occur have a length of 0.  A canonical encoding can be rebuilt from the lengths alone.
+typedef std::array<unsigned char,256> code_lengths;
+//The number of occurrences of each character, indexed by the character as an unsigned char.
+typedef std::array<size_t,256> frequency_table;
 #endif // TYPE_DEFS_H_
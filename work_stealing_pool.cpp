@@ -0,0 +1,108 @@
+#include "work_stealing_pool.h"
+#include <algorithm>
+
+//The index of the pool's thread that is running, or -1 on any other thread.
+static thread_local int worker_index = -1;
+//The pool that the running thread belongs to, so that a thread of one pool submitting to another is treated as an
+//outside thread.
+static thread_local const work_stealing_pool* worker_pool = nullptr;
+
+work_stealing_pool::work_stealing_pool(unsigned threads)
+    :next_queue(0),
+    queued(0),
+    pending(0),
+    stopping(false)
+    {
+    threads = std::max(1u,threads);
+    for(unsigned thread = 0;thread < threads;++thread){
+        queues.push_back(std::unique_ptr<worker_queue>(new worker_queue));
+    }
+    for(unsigned thread = 0;thread < threads;++thread){
+        workers.push_back(std::thread(&work_stealing_pool::work,this,thread));
+    }
+}
+
+work_stealing_pool::~work_stealing_pool(){
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    task_ready.notify_all();
+    for(auto& worker:workers){
+        worker.join();
+    }
+}
+
+void work_stealing_pool::submit(std::function<void()> task){
+    unsigned index;
+    if(worker_pool == this){
+        index = worker_index;
+    }else{
+        std::lock_guard<std::mutex> lock(mutex);
+        index = next_queue;
+        next_queue = (next_queue + 1) % queues.size();
+    }
+    ++pending;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++queued;
+    }
+    task_ready.notify_one();
+}
+
+void work_stealing_pool::wait(){
+    std::unique_lock<std::mutex> lock(mutex);
+    tasks_done.wait(lock,[this]{return pending == 0;});
+}
+
+bool work_stealing_pool::take(unsigned index,std::function<void()>& task){
+    {
+        worker_queue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if(!own.tasks.empty()){
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    //Look for work in the other queues, starting with the next one so that the threads do not all steal from the
+    //same queue.
+    for(unsigned offset = 1;offset < queues.size();++offset){
+        worker_queue& victim = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.tasks.empty()){
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void work_stealing_pool::work(unsigned index){
+    worker_index = index;
+    worker_pool = this;
+    std::function<void()> task;
+    while(true){
+        if(take(index,task)){
+            --queued;
+            task();
+            task = nullptr;
+            if(--pending == 0){
+                //The lock makes sure that wait() is either sleeping or has not checked pending yet.
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks_done.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        task_ready.wait(lock,[this]{return stopping || queued > 0;});
+        if(stopping && queued == 0)
+            return;
+    }
+}
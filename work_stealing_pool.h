@@ -0,0 +1,58 @@
+/*
+This file defines a pool of threads in which each thread has its own queue of tasks.  A task that is submitted from
+one of the pool's threads goes to the back of that thread's queue, and a thread takes its next task from the back of
+its own queue, so a task that splits its work into smaller tasks usually runs them itself, on data that is still in
+its cache.  A thread whose queue is empty steals the oldest task from the front of another thread's queue, which is
+the largest piece of work left there.  So a thread that is given a large job shares it with the threads that finish
+their small ones, without any thread having to know how large each job is ahead of time.  Each queue has its own lock,
+which is only contended when a thread steals from it.
+*/
+#ifndef WORK_STEALING_POOL_H_
+#define WORK_STEALING_POOL_H_
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class work_stealing_pool{
+public:
+    explicit work_stealing_pool(unsigned threads);
+    //Waits for the remaining tasks and stops the threads.
+    ~work_stealing_pool();
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+    //Adds a task.  Tasks submitted by one of the pool's threads go to its own queue; others are dealt to the queues
+    //in turn.
+    void submit(std::function<void()> task);
+    //Blocks until every task that was submitted, including those submitted by other tasks, is done.
+    void wait();
+
+private:
+    struct worker_queue{
+        std::mutex mutex;
+        std::deque<std::function<void()> > tasks;
+    };
+    //The loop run by each thread.
+    void work(unsigned index);
+    //Takes a task from the back of the thread's own queue, or from the front of another one.
+    bool take(unsigned index,std::function<void()>& task);
+    std::vector<std::unique_ptr<worker_queue> > queues;
+    std::vector<std::thread> workers;
+    //The queue that the next task submitted from outside of the pool goes to.
+    unsigned next_queue;
+    //Idle threads sleep on task_ready until a task is queued, and wait() sleeps on tasks_done.  queued is only
+    //incremented while holding mutex, so a thread that checks it before sleeping cannot miss a task.
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    std::condition_variable tasks_done;
+    std::atomic<size_t> queued;
+    //The number of tasks that were submitted but are not done yet.
+    std::atomic<size_t> pending;
+    bool stopping;
+};
+
+#endif // WORK_STEALING_POOL_H_